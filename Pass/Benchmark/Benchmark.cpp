@@ -0,0 +1,535 @@
+#include "IRGenerator.h"
+#include "PerfCounters.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cerrno>
+#include <fcntl.h>
+#include <spawn.h>
+#include <string>
+#include <tuple>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+extern char** environ;
+
+using namespace llvm;
+using std::string;
+using std::vector;
+
+namespace {
+
+enum class BenchPass { Parse, ReachingDefinition, SparseReachingDefinition, ScopedCSE, DataflowCSE, LazyCodeMotion };
+
+cl::list<BenchPass> Passes(
+    "pass", cl::desc("Passes to run (default: parse,rd,cse-scoped,cse-dataflow)"), cl::CommaSeparated,
+    cl::values(clEnumValN(BenchPass::Parse, "parse", "Only read the module, as a baseline"),
+               clEnumValN(BenchPass::ReachingDefinition, "rd", "ReachingDefinition, dense"),
+               clEnumValN(BenchPass::SparseReachingDefinition, "rd-sparse", "ReachingDefinition, sparse"),
+               clEnumValN(BenchPass::ScopedCSE, "cse-scoped", "CSElimination -cse-mode=scoped"),
+               clEnumValN(BenchPass::DataflowCSE, "cse-dataflow", "CSElimination -cse-mode=dataflow"),
+               clEnumValN(BenchPass::LazyCodeMotion, "cse-pre", "CSElimination -cse-mode=pre")));
+
+cl::list<unsigned> Sizes("sizes", cl::desc("Block counts to generate functions with (default: -blocks)"),
+                         cl::CommaSeparated);
+cl::list<string> Inputs(cl::Positional, cl::desc("[input .ll/.bc files instead of generated modules]"));
+
+cl::opt<string> OptPath("opt", cl::desc("opt binary to run the passes in"), cl::init(BENCHMARK_OPT));
+cl::opt<string> RDPlugin("rd-plugin", cl::desc("ReachingDefinition plugin"), cl::init(BENCHMARK_RD_PLUGIN));
+cl::opt<string> CSEPlugin("cse-plugin", cl::desc("CSElimination plugin"), cl::init(BENCHMARK_CSE_PLUGIN));
+cl::list<string> OptArgs("opt-arg", cl::desc("Extra argument for every opt run"));
+
+cl::opt<unsigned> Repeat("repeat", cl::desc("Runs per measurement; the fastest is reported"), cl::init(1));
+cl::opt<unsigned> Timeout("timeout", cl::desc("Seconds before a run is stopped (0 for none)"), cl::init(600));
+cl::opt<unsigned> MemoryLimit("memory-limit", cl::desc("Address space limit of a run in MB (0 for none)"), cl::init(0));
+cl::opt<bool> CSV("csv", cl::desc("Write comma-separated values instead of a table"));
+cl::opt<bool> KeepInputs("keep", cl::desc("Keep the generated bitcode files"));
+cl::opt<bool> Counters("counters", cl::desc("Also list hardware counters per function and phase under every row"));
+cl::opt<string> CountersCSV("counters-csv", cl::desc("Write the hardware counters per function and phase to this CSV file"),
+                            cl::value_desc("filename"));
+
+using dataflow::PerfCounters;
+
+// One measured opt run
+struct Measurement {
+    double seconds = 0;
+    long peakKB = 0; // Peak resident set size of the opt process
+    bool timedOut = false;
+    bool failed = false;
+    string status = "ok"; // Or how the run ended: "timeout", "signal N", "exit N"
+};
+
+// The hardware counts of one phase in one function, as the pass reported them
+struct PhaseCounts {
+    string function;
+    string phase;
+    int64_t counts[PerfCounters::NumEvents]; // -1 for events that were not counted
+};
+
+// What the harness knows about an input before running anything on it
+struct Input {
+    string path;
+    string label;
+    unsigned blocks = 0;
+    uint64_t instructions = 0;
+    bool generated = false;
+    unsigned requestedBlocks = 0; // Blocks per function to generate it with
+};
+
+const char* passName(BenchPass pass) {
+    switch (pass) {
+    case BenchPass::Parse: return "parse";
+    case BenchPass::ReachingDefinition: return "rd";
+    case BenchPass::SparseReachingDefinition: return "rd-sparse";
+    case BenchPass::ScopedCSE: return "cse-scoped";
+    case BenchPass::DataflowCSE: return "cse-dataflow";
+    case BenchPass::LazyCodeMotion: return "cse-pre";
+    }
+    return "";
+}
+
+// The opt command line for a pass. Results are not written anywhere, so the
+// run measures the analysis and the rewrite rather than formatting output.
+// Given a countersFile, the pass instead writes its per-phase hardware
+// counters there as JSON lines.
+vector<string> optCommand(BenchPass pass, const string& input, const string& countersFile = "") {
+    vector<string> args = {OptPath, "-enable-new-pm=0", "-disable-output"};
+    string prefix;
+    switch (pass) {
+    case BenchPass::Parse:
+        break;
+    case BenchPass::ReachingDefinition:
+    case BenchPass::SparseReachingDefinition:
+        prefix = "-rd-";
+        args.insert(args.end(), {"-load", RDPlugin, "-ReachingDefinition"});
+        args.push_back(pass == BenchPass::SparseReachingDefinition ? "-rd-mode=sparse" : "-rd-mode=dense");
+        break;
+    case BenchPass::ScopedCSE:
+    case BenchPass::DataflowCSE:
+    case BenchPass::LazyCodeMotion:
+        prefix = "-cse-";
+        args.insert(args.end(), {"-load", CSEPlugin, "-CSElimination"});
+        args.push_back(pass == BenchPass::ScopedCSE ? "-cse-mode=scoped"
+                                                    : pass == BenchPass::DataflowCSE ? "-cse-mode=dataflow" : "-cse-mode=pre");
+        break;
+    }
+    if (!prefix.empty() && !countersFile.empty()) {
+        args.insert(args.end(), {prefix + "perf-counters", prefix + "verbosity=summary", prefix + "format=json",
+                                 prefix + "output=" + countersFile});
+    } else if (!prefix.empty()) {
+        args.push_back(prefix + "verbosity=none");
+    }
+    args.insert(args.end(), OptArgs.begin(), OptArgs.end());
+    args.push_back(input);
+    return args;
+}
+
+// The run in progress, for the alarm handler to stop when it takes too long
+volatile pid_t runningChild = 0;
+volatile sig_atomic_t alarmFired = 0;
+
+void onAlarm(int) {
+    alarmFired = 1;
+    if (runningChild > 0) {
+        kill(runningChild, SIGKILL);
+    }
+}
+
+// Runs the command in a child process with its output discarded, and takes
+// its peak RSS from wait4. posix_spawn does not copy the harness's memory into
+// the child the way fork does, so the peak is opt's alone.
+Measurement runOnce(const vector<string>& command) {
+    vector<char*> argv;
+    for (const string& arg : command) {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+    posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDERR_FILENO);
+    // The child inherits the limit; the harness only waits while it is lowered
+    struct rlimit previousLimit = {};
+    getrlimit(RLIMIT_AS, &previousLimit);
+    if (MemoryLimit) {
+        struct rlimit limit = previousLimit;
+        limit.rlim_cur = rlim_t(MemoryLimit) << 20;
+        setrlimit(RLIMIT_AS, &limit);
+    }
+
+    Measurement measurement;
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid = 0;
+    int error = posix_spawn(&pid, argv[0], &actions, nullptr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    if (error) {
+        setrlimit(RLIMIT_AS, &previousLimit);
+        measurement.failed = true;
+        measurement.status = "cannot run";
+        return measurement;
+    }
+    alarmFired = 0;
+    runningChild = pid;
+    alarm(Timeout);
+    int status = 0;
+    struct rusage usage = {};
+    while (wait4(pid, &status, 0, &usage) < 0 && errno == EINTR) {
+    }
+    alarm(0);
+    runningChild = 0;
+    setrlimit(RLIMIT_AS, &previousLimit);
+
+    measurement.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    measurement.peakKB = usage.ru_maxrss;
+    if (alarmFired) {
+        measurement.timedOut = true;
+        measurement.status = "timeout";
+    } else if (WIFSIGNALED(status)) {
+        measurement.failed = true;
+        measurement.status = "signal " + std::to_string(WTERMSIG(status));
+    } else if (WEXITSTATUS(status) != 0) {
+        measurement.failed = true;
+        measurement.status = "exit " + std::to_string(WEXITSTATUS(status));
+    }
+    return measurement;
+}
+
+Measurement measure(BenchPass pass, const Input& input) {
+    vector<string> command = optCommand(pass, input.path);
+    Measurement best;
+    for (unsigned run = 0; run < std::max(1U, unsigned(Repeat)); run++) {
+        Measurement measurement = runOnce(command);
+        if (measurement.timedOut || measurement.failed) {
+            return measurement;
+        }
+        if (run == 0 || measurement.seconds < best.seconds) {
+            best.seconds = measurement.seconds;
+        }
+        best.peakKB = std::max(best.peakKB, measurement.peakKB);
+    }
+    return best;
+}
+
+// Runs the pass once more with hardware counters on and collects what it
+// reports per function and phase. This run is not timed: the summary it
+// writes is work the measured runs do not do.
+vector<PhaseCounts> countPhases(BenchPass pass, const Input& input) {
+    vector<PhaseCounts> phases;
+    SmallString<128> path;
+    if (pass == BenchPass::Parse || sys::fs::createTemporaryFile("dataflow-bench", "json", path)) {
+        return phases;
+    }
+    Measurement measurement = runOnce(optCommand(pass, input.path, string(path)));
+    ErrorOr<std::unique_ptr<MemoryBuffer>> buffer = MemoryBuffer::getFile(path);
+    sys::fs::remove(path);
+    if (measurement.timedOut || measurement.failed || !buffer) {
+        return phases;
+    }
+    StringRef lines = (*buffer)->getBuffer();
+    while (!lines.empty()) {
+        StringRef line;
+        std::tie(line, lines) = lines.split('\n');
+        Expected<json::Value> value = json::parse(line);
+        if (!value) {
+            consumeError(value.takeError());
+            continue;
+        }
+        const json::Object* record = value->getAsObject();
+        Optional<StringRef> function = record ? record->getString("function") : None;
+        Optional<StringRef> analysis = record ? record->getString("analysis") : None;
+        if (!function || !analysis || !analysis->startswith("perf:")) {
+            continue;
+        }
+        PhaseCounts phase;
+        phase.function = string(*function);
+        phase.phase = string(analysis->drop_front(strlen("perf:")));
+        for (unsigned event = 0; event < PerfCounters::NumEvents; event++) {
+            phase.counts[event] = record->getInteger(PerfCounters::eventName(event)).getValueOr(-1);
+        }
+        phases.push_back(phase);
+    }
+    return phases;
+}
+
+void printPhases(raw_ostream& out, const vector<PhaseCounts>& phases) {
+    out << "    " << left_justify("function", 20) << " " << left_justify("phase", 18);
+    for (unsigned event = 0; event < PerfCounters::NumEvents; event++) {
+        out << " " << right_justify(PerfCounters::eventName(event), 14);
+    }
+    out << "\n";
+    for (const PhaseCounts& phase : phases) {
+        out << "    " << left_justify(phase.function, 20) << " " << left_justify(phase.phase, 18);
+        for (int64_t count : phase.counts) {
+            out << " " << right_justify(count < 0 ? "-" : std::to_string(count), 14);
+        }
+        out << "\n";
+    }
+}
+
+void countInstructions(const Module& M, Input& input) {
+    for (const Function& F : M) {
+        input.blocks += F.size();
+        input.instructions += F.getInstructionCount();
+    }
+}
+
+bool generateInput(Input& input) {
+    benchmark::GeneratorConfig config = benchmark::generatorConfigFromOptions();
+    config.blocks = input.requestedBlocks;
+    LLVMContext context;
+    std::unique_ptr<Module> M = benchmark::generateModule(context, config);
+    countInstructions(*M, input);
+
+    int fd = -1;
+    SmallString<128> path;
+    if (sys::fs::createTemporaryFile("dataflow-bench", "bc", fd, path)) {
+        errs() << "dataflow-bench: cannot create a temporary file\n";
+        return false;
+    }
+    raw_fd_ostream out(fd, /*shouldClose=*/true);
+    WriteBitcodeToFile(*M, out);
+    input.path = string(path);
+    return true;
+}
+
+bool readInput(Input& input) {
+    LLVMContext context;
+    SMDiagnostic error;
+    std::unique_ptr<Module> M = parseIRFile(input.path, error, context);
+    if (!M) {
+        error.print("dataflow-bench", errs());
+        return false;
+    }
+    countInstructions(*M, input);
+    return true;
+}
+
+// Generates or reads every input in a child process, which sends back the
+// paths and counts through a pipe. Linux carries the peak RSS of a process
+// into the ones it starts, so the harness itself must never hold a module.
+bool prepareInputs(vector<Input>& inputs) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return false;
+    }
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        raw_fd_ostream out(fds[1], /*shouldClose=*/true);
+        for (Input& input : inputs) {
+            if (!(input.generated ? generateInput(input) : readInput(input))) {
+                out.flush();
+                _exit(1);
+            }
+            out << input.blocks << " " << input.instructions << " " << input.path << "\n";
+        }
+        out.flush();
+        _exit(0);
+    }
+    close(fds[1]);
+    string received;
+    char buffer[4096];
+    ssize_t length = 0;
+    while ((length = read(fds[0], buffer, sizeof(buffer))) > 0 || (length < 0 && errno == EINTR)) {
+        received.append(buffer, std::max<ssize_t>(length, 0));
+    }
+    close(fds[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+
+    StringRef lines(received);
+    for (Input& input : inputs) {
+        StringRef line;
+        std::tie(line, lines) = lines.split('\n');
+        StringRef blocks, instructions;
+        std::tie(blocks, line) = line.split(' ');
+        std::tie(instructions, line) = line.split(' ');
+        if (line.empty() || blocks.getAsInteger(10, input.blocks) || instructions.getAsInteger(10, input.instructions)) {
+            return false;
+        }
+        input.path = string(line);
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// How the time grows against the previous, smaller input: t ~ n^exponent
+string scalingExponent(const Input& input, const Measurement& measurement, const Input* previous,
+                       const Measurement* previousMeasurement) {
+    if (!previous || measurement.timedOut || measurement.failed || previousMeasurement->seconds < 0.05 ||
+        previous->instructions >= input.instructions) {
+        return "-";
+    }
+    double exponent = std::log(measurement.seconds / previousMeasurement->seconds) /
+                      std::log(double(input.instructions) / double(previous->instructions));
+    string text;
+    raw_string_ostream(text) << format("%.2f", exponent);
+    return text;
+}
+
+} // end of anonymous namespace
+
+// dataflow-bench -sizes=1000,10000,100000 -pass=rd,cse-scoped
+int main(int argc, char** argv) {
+    InitLLVM init(argc, argv);
+    cl::ParseCommandLineOptions(argc, argv,
+                                "Runs the dataflow passes over synthetic or given modules and reports wall time, "
+                                "instructions per second and peak RSS\n");
+
+    struct sigaction action = {};
+    action.sa_handler = onAlarm;
+    sigaction(SIGALRM, &action, nullptr);
+
+    vector<BenchPass> passes(Passes.begin(), Passes.end());
+    if (passes.empty()) {
+        passes = {BenchPass::Parse, BenchPass::ReachingDefinition, BenchPass::ScopedCSE, BenchPass::DataflowCSE};
+    }
+
+    vector<Input> inputs;
+    for (const string& path : Inputs) {
+        inputs.emplace_back();
+        inputs.back().path = path;
+        inputs.back().label = string(sys::path::filename(path));
+    }
+    if (Inputs.empty()) {
+        vector<unsigned> sizes(Sizes.begin(), Sizes.end());
+        if (sizes.empty()) {
+            sizes.push_back(benchmark::generatorConfigFromOptions().blocks);
+        }
+        for (unsigned blocks : sizes) {
+            inputs.emplace_back();
+            inputs.back().label = "gen-b" + std::to_string(blocks);
+            inputs.back().generated = true;
+            inputs.back().requestedBlocks = blocks;
+        }
+    }
+    if (!prepareInputs(inputs)) {
+        errs() << "dataflow-bench: cannot prepare the inputs\n";
+        return 1;
+    }
+
+    // Events the kernel cannot count here (no PMU in a VM, perf_event_paranoid)
+    // are reported as missing rather than failing the run
+    bool countPhasesToo = Counters || !CountersCSV.empty();
+    if (countPhasesToo) {
+        PerfCounters available;
+        string missing;
+        for (unsigned event = 0; event < PerfCounters::NumEvents; event++) {
+            if (!available.available(event)) {
+                missing += string(missing.empty() ? "" : ", ") + PerfCounters::eventName(event);
+            }
+        }
+        if (!available.anyAvailable()) {
+            errs() << "dataflow-bench: hardware counters unavailable, -counters is ignored\n";
+            countPhasesToo = false;
+        } else if (!missing.empty()) {
+            errs() << "dataflow-bench: cannot count " << missing << " here\n";
+        }
+    }
+    std::unique_ptr<raw_fd_ostream> countersOut;
+    if (countPhasesToo && !CountersCSV.empty()) {
+        std::error_code error;
+        countersOut.reset(new raw_fd_ostream(CountersCSV, error, sys::fs::OF_Text));
+        if (error) {
+            errs() << "dataflow-bench: cannot write " << CountersCSV << ": " << error.message() << "\n";
+            return 1;
+        }
+        *countersOut << "input,pass,function,phase";
+        for (unsigned event = 0; event < PerfCounters::NumEvents; event++) {
+            string column = PerfCounters::eventName(event);
+            std::replace(column.begin(), column.end(), '-', '_');
+            *countersOut << "," << column;
+        }
+        *countersOut << "\n";
+    }
+
+    raw_ostream& out = outs();
+    if (CSV) {
+        out << "input,blocks,instructions,pass,seconds,instructions_per_second,peak_rss_kb,scaling,status\n";
+    } else {
+        out << left_justify("input", 24) << " " << right_justify("blocks", 9) << " " << right_justify("instrs", 11) << " "
+            << left_justify("pass", 13) << " " << right_justify("wall(s)", 10) << " " << right_justify("instrs/s", 12)
+            << " " << right_justify("RSS(MB)", 10) << " " << right_justify("scaling", 7) << "\n";
+    }
+    // Per pass, the last generated input and its measurement, for the scaling column
+    vector<const Input*> previous(passes.size(), nullptr);
+    vector<Measurement> previousMeasurement(passes.size());
+    for (const Input& input : inputs) {
+        for (unsigned passNum = 0; passNum < passes.size(); passNum++) {
+            BenchPass pass = passes[passNum];
+            Measurement measurement = measure(pass, input);
+            double rate = measurement.seconds > 0 ? input.instructions / measurement.seconds : 0;
+            string scaling = input.generated ? scalingExponent(input, measurement, previous[passNum],
+                                                               &previousMeasurement[passNum])
+                                             : "-";
+            if (CSV) {
+                out << input.label << "," << input.blocks << "," << input.instructions << "," << passName(pass) << ","
+                    << format("%.4f", measurement.seconds) << "," << format("%.0f", rate) << "," << measurement.peakKB
+                    << "," << scaling << "," << measurement.status << "\n";
+            } else {
+                out << format("%-24s %9u %11llu %-13s ", input.label.c_str(), input.blocks,
+                              (unsigned long long)input.instructions, passName(pass));
+                if (measurement.timedOut || measurement.failed) {
+                    out << right_justify(measurement.status, 10) << "\n";
+                } else {
+                    out << format("%10.3f %12.0f %10.1f %7s\n", measurement.seconds, rate, measurement.peakKB / 1024.0,
+                                  scaling.c_str());
+                }
+            }
+            if (countPhasesToo && !measurement.timedOut && !measurement.failed && pass != BenchPass::Parse) {
+                vector<PhaseCounts> phases = countPhases(pass, input);
+                if (Counters && !CSV) {
+                    printPhases(out, phases);
+                }
+                if (countersOut) {
+                    for (const PhaseCounts& phase : phases) {
+                        *countersOut << input.label << "," << passName(pass) << "," << phase.function << ","
+                                     << phase.phase;
+                        for (int64_t count : phase.counts) {
+                            *countersOut << ",";
+                            if (count >= 0) {
+                                *countersOut << count;
+                            }
+                        }
+                        *countersOut << "\n";
+                    }
+                }
+            }
+            out.flush();
+            if (input.generated && !measurement.timedOut && !measurement.failed) {
+                previous[passNum] = &input;
+                previousMeasurement[passNum] = measurement;
+            }
+        }
+    }
+
+    for (const Input& input : inputs) {
+        if (!input.generated) {
+            continue;
+        }
+        if (KeepInputs) {
+            errs() << input.label << ": " << input.path << "\n";
+        } else {
+            sys::fs::remove(input.path);
+        }
+    }
+    return 0;
+}
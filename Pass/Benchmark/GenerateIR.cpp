@@ -0,0 +1,44 @@
+#include "IRGenerator.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Support/raw_ostream.h"
+#include <string>
+
+using namespace llvm;
+
+static cl::opt<std::string> OutputFilename("o", cl::desc("Output file ('-' for stdout)"), cl::value_desc("filename"),
+                                           cl::init("-"));
+static cl::opt<bool> EmitText("S", cl::desc("Write textual IR instead of bitcode"));
+
+// dataflow-gen -blocks=100000 -loop-depth=3 -S -o big.ll
+int main(int argc, char** argv) {
+    InitLLVM init(argc, argv);
+    cl::ParseCommandLineOptions(argc, argv, "Synthetic IR for the dataflow pass benchmarks\n");
+
+    LLVMContext context;
+    std::unique_ptr<Module> M = benchmark::generateModule(context, benchmark::generatorConfigFromOptions());
+    if (verifyModule(*M, &errs())) {
+        errs() << "dataflow-gen: generated module is broken\n";
+        return 1;
+    }
+
+    std::error_code error;
+    ToolOutputFile out(OutputFilename, error, EmitText ? sys::fs::OF_Text : sys::fs::OF_None);
+    if (error) {
+        errs() << "dataflow-gen: " << OutputFilename << ": " << error.message() << "\n";
+        return 1;
+    }
+    if (EmitText) {
+        M->print(out.os(), nullptr);
+    } else {
+        WriteBitcodeToFile(*M, out.os());
+    }
+    out.keep();
+    return 0;
+}
@@ -0,0 +1,219 @@
+#include "IRGenerator.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/Support/CommandLine.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+using std::vector;
+
+namespace benchmark {
+
+static cl::OptionCategory GeneratorCategory("IR generator options");
+
+static cl::opt<unsigned> Functions("functions", cl::desc("Functions per module"), cl::init(1), cl::cat(GeneratorCategory));
+static cl::opt<unsigned> Blocks("blocks", cl::desc("Basic blocks per function"), cl::init(1000), cl::cat(GeneratorCategory));
+static cl::opt<unsigned> Statements("statements", cl::desc("Computations per block"), cl::init(8), cl::cat(GeneratorCategory));
+static cl::opt<unsigned> Variables("variables", cl::desc("Local variables per function"), cl::init(16), cl::cat(GeneratorCategory));
+static cl::opt<double> StoreDensity("store-density", cl::desc("Fraction of computations stored to a variable"),
+                                    cl::init(0.3), cl::cat(GeneratorCategory));
+static cl::opt<double> Redundancy("redundancy", cl::desc("Fraction of computations repeating a recent expression"),
+                                  cl::init(0.3), cl::cat(GeneratorCategory));
+static cl::opt<unsigned> LoopDepth("loop-depth", cl::desc("Deepest loop nest"), cl::init(2), cl::cat(GeneratorCategory));
+static cl::opt<unsigned> Branching("branching", cl::desc("Most successors of a block"), cl::init(2), cl::cat(GeneratorCategory));
+static cl::opt<uint64_t> Seed("seed", cl::desc("Random seed"), cl::init(1), cl::cat(GeneratorCategory));
+
+GeneratorConfig generatorConfigFromOptions() {
+    GeneratorConfig config;
+    config.functions = Functions;
+    config.blocks = Blocks;
+    config.statementsPerBlock = Statements;
+    config.variables = Variables;
+    config.storeDensity = StoreDensity;
+    config.redundancy = Redundancy;
+    config.loopDepth = LoopDepth;
+    config.branching = Branching;
+    config.seed = Seed;
+    return config;
+}
+
+namespace {
+
+// SplitMix64: small, fast and the same everywhere
+struct Random {
+    uint64_t state;
+
+    explicit Random(uint64_t seed) : state(seed) {}
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    // Uniform in [0, bound)
+    unsigned below(unsigned bound) { return unsigned(next() % bound); }
+
+    bool chance(double probability) { return double(next() >> 11) * 0x1.0p-53 < probability; }
+};
+
+// A binary operation on two variables
+struct Expression {
+    Instruction::BinaryOps opcode;
+    unsigned left;
+    unsigned right;
+};
+
+const Instruction::BinaryOps Opcodes[] = {Instruction::Add, Instruction::Sub, Instruction::Mul,
+                                          Instruction::And, Instruction::Or,  Instruction::Xor};
+
+// Recent expressions a redundant computation picks from
+const unsigned RecentExpressions = 32;
+
+// Average number of blocks between opening a loop and closing it
+const unsigned LoopLength = 8;
+
+// The loops of a function: which blocks are headers, and the header each latch branches back to
+struct LoopPlan {
+    vector<bool> isHeader;
+    vector<unsigned> latchOf;    // Block -> header its back edge goes to, or 0 if it closes no loop
+    vector<unsigned> nextHeader; // Block -> first header after it, or the exit block
+};
+
+LoopPlan planLoops(const GeneratorConfig& config, Random& random) {
+    unsigned numBlocks = config.blocks;
+    unsigned exit = numBlocks - 1;
+    LoopPlan plan;
+    plan.isHeader.assign(numBlocks, false);
+    plan.latchOf.assign(numBlocks, 0);
+    plan.nextHeader.assign(numBlocks, exit);
+
+    // Blocks 1 to exit - 1 can be in loops; each closes at most one, so the
+    // last open loops are closed one per block before the exit
+    vector<unsigned> open;
+    for (unsigned block = 1; block < exit; block++) {
+        unsigned latchesLeft = exit - block;
+        if (open.size() < config.loopDepth && open.size() + 1 <= latchesLeft && random.chance(1.0 / LoopLength)) {
+            plan.isHeader[block] = true;
+            open.push_back(block);
+        }
+        if (!open.empty() && (open.size() >= latchesLeft || random.chance(1.0 / LoopLength))) {
+            plan.latchOf[block] = open.back();
+            open.pop_back();
+        }
+    }
+    for (unsigned block = exit - 1; block > 0; block--) {
+        plan.nextHeader[block - 1] = plan.isHeader[block] ? block : plan.nextHeader[block];
+    }
+    return plan;
+}
+
+void generateFunction(Module& M, const GeneratorConfig& config, unsigned functionNum, Random& random) {
+    LLVMContext& context = M.getContext();
+    Type* int32 = Type::getInt32Ty(context);
+    auto* F = Function::Create(FunctionType::get(int32, {int32}, false), Function::ExternalLinkage,
+                               "f" + std::to_string(functionNum), M);
+    Argument* arg = F->getArg(0);
+    arg->setName("arg");
+
+    unsigned numBlocks = config.blocks;
+    vector<BasicBlock*> blocks(numBlocks);
+    blocks[0] = BasicBlock::Create(context, "entry", F);
+    for (unsigned block = 1; block < numBlocks; block++) {
+        blocks[block] = BasicBlock::Create(context, "b" + std::to_string(block), F);
+    }
+    LoopPlan plan = planLoops(config, random);
+
+    // Every variable starts out defined, from the argument or a constant
+    IRBuilder<> builder(blocks[0]);
+    vector<AllocaInst*> variables(config.variables);
+    for (unsigned variable = 0; variable < config.variables; variable++) {
+        variables[variable] = builder.CreateAlloca(int32, nullptr, "v" + std::to_string(variable));
+    }
+    for (unsigned variable = 0; variable < config.variables; variable++) {
+        Value* initial = variable % 2 ? static_cast<Value*>(builder.getInt32(variable)) : arg;
+        builder.CreateStore(initial, variables[variable]);
+    }
+    builder.CreateBr(blocks[1]);
+
+    vector<Expression> expressions;
+    auto loadVariable = [&](unsigned variable) { return builder.CreateLoad(int32, variables[variable]); };
+    for (unsigned block = 1; block < numBlocks; block++) {
+        builder.SetInsertPoint(blocks[block]);
+        for (unsigned statement = 0; statement < config.statementsPerBlock; statement++) {
+            Expression expression;
+            if (!expressions.empty() && random.chance(config.redundancy)) {
+                unsigned recent = std::min<unsigned>(expressions.size(), RecentExpressions);
+                expression = expressions[expressions.size() - 1 - random.below(recent)];
+            } else {
+                expression = {Opcodes[random.below(array_lengthof(Opcodes))], random.below(config.variables),
+                              random.below(config.variables)};
+                expressions.push_back(expression);
+            }
+            Value* result = builder.CreateBinOp(expression.opcode, loadVariable(expression.left),
+                                                loadVariable(expression.right));
+            if (random.chance(config.storeDensity)) {
+                builder.CreateStore(result, variables[random.below(config.variables)]);
+            }
+        }
+
+        if (block == numBlocks - 1) {
+            builder.CreateRet(loadVariable(0));
+            continue;
+        }
+        Value* condition = loadVariable(random.below(config.variables));
+        if (plan.latchOf[block]) {
+            builder.CreateCondBr(builder.CreateICmpSLT(condition, builder.getInt32(random.below(64))),
+                                 blocks[plan.latchOf[block]], blocks[block + 1]);
+            continue;
+        }
+
+        // Forward edges stay before the next loop header, so no loop is entered past its header
+        unsigned limit = std::min(plan.nextHeader[block], block + 4 * std::max(config.branching, 1U));
+        unsigned numSuccessors = 1 + random.below(std::max(config.branching, 1U));
+        vector<unsigned> successors = {block + 1};
+        for (unsigned attempt = 0; attempt < 2 * numSuccessors && successors.size() < numSuccessors; attempt++) {
+            if (limit <= block + 1) {
+                break;
+            }
+            unsigned target = block + 2 + random.below(limit - block - 1);
+            if (std::find(successors.begin(), successors.end(), target) == successors.end()) {
+                successors.push_back(target);
+            }
+        }
+        if (successors.size() == 1) {
+            builder.CreateBr(blocks[successors[0]]);
+        } else if (successors.size() == 2) {
+            builder.CreateCondBr(builder.CreateICmpSLT(condition, builder.getInt32(random.below(64))),
+                                 blocks[successors[0]], blocks[successors[1]]);
+        } else {
+            SwitchInst* switchInst = builder.CreateSwitch(condition, blocks[successors[0]], successors.size() - 1);
+            for (unsigned i = 1; i < successors.size(); i++) {
+                switchInst->addCase(builder.getInt32(i), blocks[successors[i]]);
+            }
+        }
+    }
+}
+
+} // end of anonymous namespace
+
+std::unique_ptr<Module> generateModule(LLVMContext& context, const GeneratorConfig& config) {
+    GeneratorConfig shape = config;
+    shape.blocks = std::max(shape.blocks, 3U);
+    shape.variables = std::max(shape.variables, 1U);
+
+    auto M = std::make_unique<Module>("bench-b" + std::to_string(shape.blocks), context);
+    Random random(shape.seed);
+    for (unsigned functionNum = 0; functionNum < shape.functions; functionNum++) {
+        generateFunction(*M, shape, functionNum, random);
+    }
+    return M;
+}
+
+} // end of namespace benchmark
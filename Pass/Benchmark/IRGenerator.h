@@ -0,0 +1,39 @@
+#ifndef CS201_BENCHMARK_IRGENERATOR_H
+#define CS201_BENCHMARK_IRGENERATOR_H
+
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include <cstdint>
+#include <memory>
+
+namespace benchmark {
+
+// Shape of the generated functions. Each one reads and writes a set of local
+// variables the way clang -O0 output does: every statement loads its operands
+// from the variables, computes one binary operation, and may store the result
+// back. Loops are properly nested and entered only through their header, so
+// the CFG stays reducible at any size.
+struct GeneratorConfig {
+    unsigned functions = 1;
+    unsigned blocks = 1000;          // Basic blocks per function, entry and exit included (at least 3)
+    unsigned statementsPerBlock = 8; // Computations per block
+    unsigned variables = 16;         // Local variables (allocas) per function
+    double storeDensity = 0.3;       // Fraction of computations whose result is stored to a variable
+    double redundancy = 0.3;         // Fraction of computations that repeat a recent expression
+    unsigned loopDepth = 2;          // Deepest loop nest (0 for an acyclic CFG)
+    unsigned branching = 2;          // Most successors of a block that does not close a loop
+    uint64_t seed = 1;
+};
+
+// Builds the module. The same configuration gives the same module on every
+// platform: the random numbers come from a fixed generator, not from <random>,
+// whose distributions differ between standard libraries.
+std::unique_ptr<llvm::Module> generateModule(llvm::LLVMContext& context, const GeneratorConfig& config);
+
+// The configuration given by the generator's command-line options, which
+// every tool linking IRGenerator.cpp accepts
+GeneratorConfig generatorConfigFromOptions();
+
+} // end of namespace benchmark
+
+#endif
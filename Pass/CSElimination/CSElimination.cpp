@@ -1,784 +1,1082 @@
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/ScopedHashTable.h"
 #include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Dominators.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Module.h"
+#include "llvm/IR/ModuleSlotTracker.h"
+#include "llvm/IR/PassManager.h"
 #include "llvm/IR/Value.h"
+#include "llvm/IR/ValueHandle.h"
 #include "llvm/Pass.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/RecyclingAllocator.h"
 #include "llvm/Support/raw_ostream.h"
-#include <fstream>
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "llvm/Transforms/Utils/Local.h"
+#include "llvm/Transforms/Utils/SSAUpdater.h"
+#include "AvailableExpressions.h"
+#include "CFGIndex.h"
+#include "DataflowAnalyses.h"
+#include "DataflowFramework.h"
+#include "InstructionIndex.h"
+#include "LazyCodeMotion.h"
+#include "PhaseTimer.h"
+#include "ReachingDefinitionSets.h"
+#include "ResultWriter.h"
+#include "ValueNumbering.h"
+#include <algorithm>
 #include <iostream>
-#include <queue>
-#include <set>
+#include <memory>
 #include <string>
-#include <unordered_map>
 
 using namespace llvm;
 using namespace std;
 
 #define DEBUG_TYPE "CSElimination"
 
+STATISTIC(NumBlocks, "Number of blocks analyzed");
+STATISTIC(NumDefinitions, "Number of definitions in the reaching definitions");
+STATISTIC(NumExpressions, "Number of expressions interned by value numbering");
+STATISTIC(NumSolverVisits, "Number of block visits by the dataflow solvers");
+STATISTIC(NumEliminated, "Number of redundant computations eliminated");
+STATISTIC(NumInserted, "Number of computations inserted by lazy code motion");
+STATISTIC(NumLoadsInserted, "Number of loads inserted to recompute moved expressions");
+STATISTIC(NumLoadsEliminated, "Number of redundant loads eliminated");
+STATISTIC(NumStoresForwarded, "Number of loads replaced by a stored value");
+
 namespace {
-vector<unsigned> AddNumToVectorElements(vector<unsigned> vec, unsigned int val) {
-    for (unsigned int i = 0; i < vec.size(); i++) {
-        vec.at(i) = vec.at(i) + val;
-    }
-    return vec;
-}
+enum class CSEEngine { Scoped, Dataflow, PartialRedundancy };
+
+static cl::opt<CSEEngine> CSEMode(
+    "cse-mode", cl::desc("How redundant computations are found"), cl::init(CSEEngine::Scoped),
+    cl::values(clEnumValN(CSEEngine::Scoped, "scoped", "Scoped hash table over the dominator tree"),
+               clEnumValN(CSEEngine::Dataflow, "dataflow", "Global available expressions, also across joins"),
+               clEnumValN(CSEEngine::PartialRedundancy, "pre", "Lazy code motion, also for partially redundant computations")));
+
+static cl::opt<bool> CSELoads(
+    "cse-loads", cl::desc("Also replace loads of local variables by the value last stored or loaded"), cl::init(false));
+
+static cl::opt<bool> CSEVerifyUpdates(
+    "cse-verify-updates", cl::Hidden,
+    cl::desc("Check each incremental update of the dataflow sets against a fresh computation"), cl::init(false));
+
+static cl::opt<dataflow::Verbosity> CSEVerbosity(
+    "cse-verbosity", cl::desc("How much of the analysis to report"), cl::init(dataflow::Verbosity::Sets),
+    cl::values(clEnumValN(dataflow::Verbosity::None, "none", "Nothing"),
+               clEnumValN(dataflow::Verbosity::Summary, "summary", "Function headers, solver counts and the lines to rewrite"),
+               clEnumValN(dataflow::Verbosity::Sets, "sets", "Per-block reaching definitions and available expressions"),
+               clEnumValN(dataflow::Verbosity::Trace, "trace", "Every step of building the sets (debug builds only)")));
+
+static cl::opt<dataflow::OutputFormat> CSEFormat(
+    "cse-format", cl::desc("Format of the reported sets"), cl::init(dataflow::OutputFormat::Text),
+    cl::values(clEnumValN(dataflow::OutputFormat::Text, "text", "Human-readable listing"),
+               clEnumValN(dataflow::OutputFormat::JSON, "json", "One JSON object per line"),
+               clEnumValN(dataflow::OutputFormat::Binary, "binary", "Little-endian record stream")));
+
+static cl::opt<string> CSEOutput(
+    "cse-output", cl::desc("File to write the results to ('-' for stderr)"), cl::value_desc("filename"), cl::init("-"));
+
+static cl::opt<bool> CSEPerfCounters(
+    "cse-perf-counters",
+    cl::desc("Report hardware counters (cycles, instructions, cache and branch misses, page faults) per phase"),
+    cl::init(false));
+
+// A computation of an expression that is still available where it happens
+struct Redundancy {
+    Instruction* inst;
+    unsigned expression;
+    Instruction* earlier; // Computation earlier in the same block, or null if the value comes from other blocks
+};
+
+// A computation of an expression that is not redundant, with its instruction index
+struct Computation {
+    Instruction* inst;
+    unsigned expression;
+    unsigned index;
+    bool reused; // Its value flows to redundant computations in other blocks
+};
 
-vector<unsigned> sortAndRemoveDuplicates(vector<unsigned> vec) {
-    set<unsigned> vecAsSet(vec.begin(), vec.end());
-    vector<unsigned> temp(vecAsSet.begin(), vecAsSet.end());
-    return temp;
+// Erases computations whose uses were all replaced, then whatever only they
+// used, such as their operand loads. Runs once all replacements are done, so
+// no value another replacement still needs is deleted early. The blocks
+// anything was erased from are added to edited, if given.
+void eraseReplaced(ArrayRef<Instruction*> replaced, SmallPtrSetImpl<BasicBlock*>* edited = nullptr) {
+    SmallVector<WeakTrackingVH, 16> operands;
+    for (Instruction* inst : replaced) {
+        for (Value* operand : inst->operands()) {
+            if (isa<Instruction>(operand)) {
+                operands.push_back(operand);
+            }
+        }
+        if (edited) {
+            edited->insert(inst->getParent());
+        }
+        inst->eraseFromParent();
+    }
+    RecursivelyDeleteTriviallyDeadInstructionsPermissive(operands, nullptr, nullptr, [&](Value* value) {
+        if (edited) {
+            edited->insert(cast<Instruction>(value)->getParent());
+        }
+    });
 }
 
-string GetInstrDestination(Instruction& instr, unsigned opNumber) {
-    string temp = "";
-    raw_string_ostream stream(temp);
-    instr.print(stream);
-    string instrString = stream.str();
-
-    if (opNumber == 1) {
-        unsigned instrPercentIndex = instrString.find("%", 0);
-        unsigned instrEqualIndex = instrString.find(" =", instrPercentIndex); // Find index of " ="
-        return instrString.substr(instrPercentIndex, instrEqualIndex - instrPercentIndex);
-    }
-    // Isolate operand for store instructions
-    // For 'Store i32 %10, i32* %2, align 4 (store w/ destination:   %2 = alloca i32, align 4)', isolate %10
-    else if (opNumber == 2) {
-        unsigned instrPercentIndex = instrString.find("%", 0);                // Find index of first %
-        unsigned instrCommaIndex = instrString.find(", ", instrPercentIndex); // Find index of second ,
-        return instrString.substr(instrPercentIndex, instrCommaIndex - instrPercentIndex);
-    }
-    return "ERROR";
+// Computes expression number again right before insertPoint, from fresh loads
+// of the variables it reads. Only for lazy code motion candidates, whose
+// other leaves are constants, arguments and static allocas. The copy gets no
+// nsw/nuw, exact or inbounds flags, since it stands in for every computation
+// it makes redundant.
+Instruction* materialize(const dataflow::ValueNumbering& numbering, unsigned number, Instruction* insertPoint) {
+    Instruction* inst = numbering.representatives[number]->clone();
+    for (unsigned i = 0; i < inst->getNumOperands(); i++) {
+        dataflow::OperandId operand = numbering.operandAt(number, i);
+        Value* value = nullptr;
+        if (dataflow::isExpressionOperand(operand)) {
+            value = materialize(numbering, dataflow::operandExpression(operand), insertPoint);
+        } else if (numbering.isTracked(dataflow::operandLeaf(operand))) {
+            auto* variable = cast<AllocaInst>(const_cast<Value*>(dataflow::operandLeaf(operand)));
+            value = new LoadInst(variable->getAllocatedType(), variable, "", insertPoint);
+            ++NumLoadsInserted;
+        } else {
+            value = const_cast<Value*>(dataflow::operandLeaf(operand));
+        }
+        inst->setOperand(i, value);
+    }
+    inst->dropPoisonGeneratingFlags();
+    inst->insertBefore(insertPoint);
+    return inst;
 }
 
-string GetValueOperand(const Value* value, unsigned opNumber) {
-    // Convert Value to a string, referenced this page:
-    // https://llvm.org/doxygen/classllvm_1_1raw__string__ostream.html
-    string temp = "";
-    raw_string_ostream opStream(temp);
-    value->print(opStream);
-    string op1 = opStream.str();
+// Replaces every redundant computation by the value it repeats, in program
+// order so one reusing an earlier redundant computation picks up its
+// replacement. That is the earlier computation when there is one in the same
+// block. Otherwise the value flows in from the reused computations of other
+// blocks, joined by phis where their paths meet, placed by SSAUpdater as
+// mem2reg would for a slot they all stored to. Such a redundant computation
+// comes before any computation of its expression in its own block, so it
+// takes the value live into the block.
+//
+// The computations that stay may now stand in for ones without nsw/nuw,
+// exact or inbounds, so each keeps only the flags every computation of its
+// expression has. Returns the replaced computations, still in the IR. The
+// blocks that got a phi or an instruction with a replaced operand are added
+// to edited, if given.
+vector<Instruction*> replaceRedundancies(ArrayRef<Redundancy> redundancies, ArrayRef<Computation> computations,
+                                         unsigned numExpressions, SmallPtrSetImpl<BasicBlock*>* edited = nullptr) {
+    vector<Instruction*> flagsOf(numExpressions, nullptr);
+    for (const Redundancy& redundancy : redundancies) {
+        Instruction*& flags = flagsOf[redundancy.expression];
+        if (!flags) {
+            flags = redundancy.inst;
+        } else {
+            flags->andIRFlags(redundancy.inst);
+        }
+    }
 
-    string operand1 = "";
+    // Counting sort of the reused computations by expression, keeping program order
+    vector<unsigned> reusedOffsets(numExpressions + 1, 0);
+    for (const Computation& computation : computations) {
+        if (Instruction* flags = flagsOf[computation.expression]) {
+            computation.inst->andIRFlags(flags);
+        }
+        if (computation.reused) {
+            reusedOffsets[computation.expression + 1]++;
+        }
+    }
+    for (unsigned number = 0; number < numExpressions; number++) {
+        reusedOffsets[number + 1] += reusedOffsets[number];
+    }
+    vector<Instruction*> reused(reusedOffsets.back());
+    vector<unsigned> next(reusedOffsets.begin(), reusedOffsets.end() - 1);
+    for (const Computation& computation : computations) {
+        if (computation.reused) {
+            reused[next[computation.expression]++] = computation.inst;
+        }
+    }
 
-    // Isolate operand for assignment instructions
-    // For '%10 = sub nsw i32 %8, %9', isolate %10
-    if (opNumber == 1) {
-        unsigned op1PercentIndex = op1.find("%", 0);              // Find index of first %
-        unsigned op1CommaIndex = op1.find(" =", op1PercentIndex); // Find index of second ,
-        operand1 = op1.substr(op1PercentIndex, op1CommaIndex - op1PercentIndex);
+    // Values from other blocks, one expression at a time
+    vector<const Redundancy*> fromOtherBlocks;
+    for (const Redundancy& redundancy : redundancies) {
+        if (!redundancy.earlier) {
+            fromOtherBlocks.push_back(&redundancy);
+        }
     }
-    // Isolate operand for load instructions
-    // For ''%6 = load i32, i32* %b, align 4', isolate %b
-    else if (opNumber == 2) {
-        unsigned op1PercentIndex = op1.find("%", 3);             // Find index of second %
-        unsigned op1CommaIndex = op1.find(",", op1PercentIndex); // Find index of second ,
-        operand1 = op1.substr(op1PercentIndex, op1CommaIndex - op1PercentIndex);
+    std::stable_sort(fromOtherBlocks.begin(), fromOtherBlocks.end(),
+                     [](const Redundancy* a, const Redundancy* b) { return a->expression < b->expression; });
+    DenseMap<Instruction*, Value*> replacements;
+    SmallVector<PHINode*, 8> insertedPhis;
+    SSAUpdater ssa(&insertedPhis);
+    for (unsigned i = 0; i < fromOtherBlocks.size(); i++) {
+        unsigned number = fromOtherBlocks[i]->expression;
+        if (i == 0 || fromOtherBlocks[i - 1]->expression != number) {
+            ssa.Initialize(fromOtherBlocks[i]->inst->getType(), "cse");
+            for (unsigned r = reusedOffsets[number]; r < reusedOffsets[number + 1]; r++) {
+                ssa.AddAvailableValue(reused[r]->getParent(), reused[r]);
+            }
+        }
+        Instruction* inst = fromOtherBlocks[i]->inst;
+        replacements[inst] = ssa.GetValueInMiddleOfBlock(inst->getParent());
     }
 
-    return operand1;
+    vector<Instruction*> replaced;
+    for (const Redundancy& redundancy : redundancies) {
+        Instruction* inst = redundancy.inst;
+        Value* value = replacements.lookup(redundancy.earlier ? redundancy.earlier : inst);
+        if (!value) {
+            value = redundancy.earlier;
+        }
+        if (edited) {
+            for (User* user : inst->users()) {
+                edited->insert(cast<Instruction>(user)->getParent());
+            }
+        }
+        inst->replaceAllUsesWith(value);
+        replacements[inst] = value;
+        replaced.push_back(inst);
+    }
+    if (edited) {
+        for (PHINode* phi : insertedPhis) {
+            edited->insert(phi->getParent());
+        }
+    }
+    return replaced;
 }
 
-struct Expression {
-    string operand1;
-    string operand2;
-    string opcode;
-    unsigned index;
-
-    // Overload equality operator to compare Expressions
-    // Indices can be different
-    bool operator==(const Expression& exp) const {
-        return (operand1 == exp.operand1) && (operand2 == exp.operand2) && (opcode == exp.opcode) && (index == exp.index);
+// Reports the reaching definitions and available expressions of F, as the
+// first round of eliminateCommonSubexpressions found them
+void reportDataflowSets(Function& F, const dataflow::AvailableExpressionSets& availableExprs,
+                        const dataflow::ReachingDefinitionSets& reachingDefs, dataflow::ResultWriter& writer) {
+    if (raw_ostream* out = writer.textAt(dataflow::Verbosity::Summary)) {
+        *out << "Available expressions converged after " << availableExprs.iterations << " block visits\n";
     }
+    writer.counter("available-expressions", "block-visits", availableExprs.iterations);
 
-    // For set operations
-    bool operator<(const Expression& exp) const {
-        return index < exp.index;
-    }
+    // ===============================
+    //    FIND REACHING DEFINITIONS
+    // ===============================
 
-    Expression(string op1Value, string op2Value, string opnum, unsigned loc) {
-        operand1 = op1Value;
-        operand2 = op2Value;
-        opcode = opnum;
-        index = loc;
+    if (raw_ostream* out = writer.textAt(dataflow::Verbosity::Sets)) {
+        *out << "\nFinding Reaching Definitions for function: " << F.getName();
     }
 
-    Expression(const Value* op1Value, const Value* op2Value, const unsigned opnum, unsigned loc) {
-        operand1 = GetValueOperand(op1Value, 2);
-        operand2 = GetValueOperand(op2Value, 2);
-
-        if (opnum == 13) {
-            opcode = "+";
-        } else if (opnum == 15) {
-            opcode = "-";
-        } else if (opnum == 17) {
-            opcode = "*";
-        } else if (opnum == 20) {
-            opcode = "/";
-        } else {
-            errs() << "Something bad happened! :(\n";
-            errs() << "opnum wasn't what we expected. It was: " << opnum << "\n";
-            exit(1);
+    // Report IN, GEN, KILL, OUT for each block's reaching definitions
+    if (writer.enabled(dataflow::Verbosity::Sets)) {
+        SmallVector<unsigned, 16> in, gen, kill, out;
+        for (unsigned int i = 0; i < reachingDefs.genSets.size(); ++i) {
+            reachingDefs.instrIndicesOf(reachingDefs.inSets.at(i), in);
+            reachingDefs.instrIndicesOf(reachingDefs.genSets.at(i), gen);
+            reachingDefs.instrIndicesOf(reachingDefs.killSets.at(i), kill);
+            reachingDefs.instrIndicesOf(reachingDefs.outSets.at(i), out);
+            writer.blockSets("reaching-definitions", i, {{"IN", in}, {"GEN", gen}, {"KILL", kill}, {"OUT", out}});
         }
-
-        index = loc;
     }
-
-    void print() const {
-        errs() << operand1 << " " << opcode << " " << operand2 << " @ index " << index << "\n";
+    if (raw_ostream* out = writer.textAt(dataflow::Verbosity::Summary)) {
+        *out << "\nReaching definitions converged after " << reachingDefs.iterations << " block visits\n";
+    }
+    writer.counter("reaching-definitions", "block-visits", reachingDefs.iterations);
+
+    // ===============================
+    //    END REACHING DEFINITIONS
+    // ===============================
+
+    // Report all IN, GEN, KILL, and OUT sets for every block's available expressions
+    if (raw_ostream* out = writer.textAt(dataflow::Verbosity::Sets)) {
+        // Numbers the function's unnamed values once for all the expressions below
+        ModuleSlotTracker slots(F.getParent());
+        slots.incorporateFunction(F);
+        *out << "\nAvailable Expressions for each block:";
+        const vector<BitVector>* sets[] = {&availableExprs.inSets, &availableExprs.genSets, &availableExprs.killSets, &availableExprs.outSets};
+        const char* setNames[] = {"IN", "GEN", "KILL", "OUT"};
+        for (unsigned i = 0; i < availableExprs.inSets.size(); ++i) {
+            *out << "\nBlock " << i << " available expressions:";
+            for (unsigned setNum = 0; setNum < 4; ++setNum) {
+                *out << (setNum == 0 ? "\n  " : "  ") << setNames[setNum] << ":\n";
+                for (unsigned number : (*sets[setNum])[i].set_bits()) {
+                    *out << "    ";
+                    availableExprs.expressionAt(number).print(*out, &slots);
+                }
+            }
+        }
+        *out << "\n";
+    } else if (writer.enabled(dataflow::Verbosity::Sets)) {
+        // Expressions are identified by the index of the first instruction that computes them
+        SmallVector<unsigned, 16> in, gen, kill, out;
+        for (unsigned i = 0; i < availableExprs.inSets.size(); ++i) {
+            availableExprs.instrIndicesOf(availableExprs.inSets.at(i), in);
+            availableExprs.instrIndicesOf(availableExprs.genSets.at(i), gen);
+            availableExprs.instrIndicesOf(availableExprs.killSets.at(i), kill);
+            availableExprs.instrIndicesOf(availableExprs.outSets.at(i), out);
+            writer.blockSets("available-expressions", i, {{"IN", in}, {"GEN", gen}, {"KILL", kill}, {"OUT", out}});
+        }
     }
-};
-
-bool expsEqualWithoutIndex(const Expression& exp1, const Expression& exp2) {
-    return (exp1.operand1 == exp2.operand1) && (exp1.operand2 == exp2.operand2) && (exp1.opcode == exp2.opcode);
 }
 
-struct CSElimination : public FunctionPass {
-    static char ID;
-    CSElimination() : FunctionPass(ID) {}
+// Reports the analysis results, finds the redundant computations (PASS 5)
+// and removes them from the IR (PASS 6), as one round of
+// eliminateToFixpoint. The sets are only reported in the first round, and
+// later rounds only report what they found. Returns whether F was changed,
+// with the numbers of the blocks that were in changedBlocks.
+bool eliminateCommonSubexpressions(Function& F, const dataflow::CFGIndex& cfg, const dataflow::InstructionIndex& instrs,
+                                   const dataflow::AvailableExpressionSets& availableExprs,
+                                   const dataflow::ReachingDefinitionSets& reachingDefs, dataflow::ResultWriter& writer,
+                                   raw_ostream& output, unsigned round, SmallVectorImpl<unsigned>& changedBlocks) {
+    dataflow::PhaseTimer phases("cse", "Common subexpression elimination", F.getName());
+    NumSolverVisits += availableExprs.iterations + reachingDefs.iterations;
+    if (round == 0) {
+        phases.start("cse-report", "Report the dataflow sets");
+        NumBlocks += availableExprs.inSets.size();
+        NumDefinitions += reachingDefs.numDefinitions();
+        NumExpressions += availableExprs.numExpressions();
+        reportDataflowSets(F, availableExprs, reachingDefs, writer);
+    }
 
-    bool runOnFunction(Function& F) override {
-        errs() << "\nFunction: " << F.getName() << "\n";
-
-        // Vectors look like {{""}, {"a - e", "a + b"}, {"a + b"}, {""}}
-        vector<vector<Expression*>> blockGenSetsAvail = {};
-        vector<vector<Expression*>> blockKilledSetsAvail = {};
-        vector<vector<Expression*>> blockInSetsAvail = {};
-        vector<vector<Expression*>> blockOutSetsAvail = {};
-        unsigned blockNum = 0;
-
-        // PASS 1: Create GEN sets for each block
-        errs() << "PASS 1: Create GEN sets for each block\n";
-        unsigned instructionIndex = 0;
-        for (auto& basic_block : F) { // Iterates over basic blocks of the function
-            errs() << "Block " << blockNum++ << ":\n";
-
-            vector<Expression*> currGenSet = {}; // Current block's GEN set
-
-            for (auto& inst : basic_block) { // Iterates over instructions in a basic block
-                // Find statements A = B op C where op is {+, -, *, /}
-                if (inst.getOpcode() == Instruction::Add || inst.getOpcode() == Instruction::Sub || inst.getOpcode() == Instruction::Mul || inst.getOpcode() == Instruction::SDiv) {
-                    Value* op1 = inst.getOperand(0);
-                    Value* op2 = inst.getOperand(1);
-                    errs() << "  Found A = B op C: op1 is \'" << *op1 << "\', op2 is \'" << *op2 << "\', opcode " << inst.getOpcode() << "\n";
-
-                    // Both operands should look like '%22 = load i32, i32* %2, align 4'
-                    // If either operand is NOT a load, it's an immediate; ignore those
-                    if (isa<LoadInst>(op1) && isa<LoadInst>(op2)) {
-                        // Add expressions to this block's GEN set
-                        Expression* exp = new Expression(op1, op2, inst.getOpcode(), instructionIndex);
-                        currGenSet.push_back(exp);
-                    } else {
-                        errs() << "  Found A = B op C, but A or B is an immediate value.\n";
-                    }
+    // PASS 5: Find the redundant computations
+    // Each block is walked from its IN set, so A = B op C is redundant when B op C
+    // is still available there: either computed earlier in the block, whose value
+    // is reused directly, or available at entry, in which case the value comes from
+    // the computations of B op C that reach the block, joined by phis.
+    DATAFLOW_TRACE(writer, "PASS 5: Find redundant computations\n");
+    phases.start("cse-find", "Find redundant computations");
+    unsigned numExpressions = availableExprs.numExpressions();
+    vector<Redundancy> redundancies = {};
+    vector<unsigned> redundantLines = {};
+    // The computations that stay, in program order, in one flat list for the whole function
+    vector<Computation> computations = {};
+    BitVector reusedAcross(numExpressions); // Expressions whose value some other block reuses
+    // Per-block state, reused from block to block so its storage is only allocated once
+    BitVector available;
+    DenseMap<unsigned, Instruction*> computedHere; // Expression -> its first computation in this block since it was last killed
+    for (unsigned blockNum = 0; blockNum < availableExprs.inSets.size(); blockNum++) {
+        available = availableExprs.inSets.at(blockNum);
+        computedHere.clear();
+        for (unsigned instructionIndex = instrs.blockStart[blockNum]; instructionIndex < instrs.blockStart[blockNum + 1]; instructionIndex++) {
+            Instruction& inst = *instrs.at(instructionIndex);
+            if (const auto* store = dyn_cast<StoreInst>(&inst)) {
+                for (unsigned number : availableExprs.expressionsReading(store->getPointerOperand())) {
+                    available.reset(number);
+                    computedHere.erase(number);
                 }
-                instructionIndex++;
-            }
-            blockGenSetsAvail.push_back(currGenSet);
-        }
-        errs() << "\n";
-
-        // Print GEN sets for each block
-        errs() << "Print GEN sets for each block:\n";
-        for (unsigned i = 0; i < blockGenSetsAvail.size(); i++) {
-            errs() << "Block " << i << " GEN set:\n";
-            for (unsigned j = 0; j < blockGenSetsAvail.at(i).size(); j++) {
-                errs() << "  ";
-                blockGenSetsAvail.at(i).at(j)->print();
-            }
-        }
-        errs() << "\n";
-
-        blockNum = 0;
-
-        // PASS 2: Create KILL sets for each block
-        errs() << "PASS 2: Create KILL sets for each block\n";
-        instructionIndex = 0;
-        for (auto& basic_block : F) { // Iterates over basic blocks of the function
-            errs() << "Block " << blockNum << ":\n";
-
-            vector<Expression*> currKilledSet = {}; // Current block's KILL set
-
-            for (auto& inst : basic_block) { // Iterates over instructions in a basic block
-                // Find statements A = ~ where A is an operand in this block's expressions
-                if (inst.getOpcode() == Instruction::Store) {
-                    string storeDestination = GetValueOperand(inst.getOperand(1), 1);
-                    errs() << "  Found A = B op C where A is \'" << storeDestination << "\'\n";
-
-                    // Check if an expression in this block used the same storeDestination as an operand
-                    unsigned numGenExpsInBlock = blockGenSetsAvail.at(blockNum).size();
-                    for (unsigned j = 0; j < numGenExpsInBlock; j++) {
-                        Expression* genSetExpression = blockGenSetsAvail.at(blockNum).at(j);
-                        errs() << "    Checking GEN expression " << j << " in block " << blockNum << "...\n";
-
-                        // FIXME: currently only looking at current block GEN set, not IN set of predecessors
-                        // Does destination match either operand in this expression?
-                        if (storeDestination == genSetExpression->operand1 || storeDestination == genSetExpression->operand2) {
-                            errs() << "      Found match: ";
-                            genSetExpression->print();
-
-                            // Add the *killed* expression to this block's kill set
-                            // Index of the killed expression is where it was killed
-                            Expression* killedExp = new Expression(
-                                genSetExpression->operand1,
-                                genSetExpression->operand2,
-                                genSetExpression->opcode,
-                                instructionIndex);
-                            currKilledSet.push_back(killedExp);
-                        }
+            } else {
+                int expNumber = availableExprs.expressionOf(inst);
+                if (expNumber >= 0 && available.test(expNumber)) {
+                    Instruction* earlier = computedHere.lookup(expNumber);
+                    DATAFLOW_TRACE(writer, "  Index " << instructionIndex << " is redundant, value from "
+                                                      << (earlier ? "this block" : "other blocks") << "\n");
+                    redundancies.push_back({&inst, unsigned(expNumber), earlier});
+                    redundantLines.push_back(instructionIndex);
+                    if (!earlier) {
+                        reusedAcross.set(expNumber);
+                        computedHere[expNumber] = &inst;
                     }
-                }
-                instructionIndex++;
-            }
-            blockKilledSetsAvail.push_back(currKilledSet);
-            blockNum++;
-        }
-        errs() << "\n";
-
-        // Print KILL sets for each block
-        errs() << "Print KILL sets for each block:\n";
-        for (unsigned i = 0; i < blockKilledSetsAvail.size(); i++) {
-            errs() << "Block " << i << " KILL set:\n";
-            for (unsigned j = 0; j < blockKilledSetsAvail.at(i).size(); j++) {
-                errs() << "  ";
-                blockKilledSetsAvail.at(i).at(j)->print();
-            }
-        }
-        errs() << "\n";
-
-        // PASS 3: If exp1 kills exp2 in a block and exp1 comes after exp2, remove exp2 from block's GEN set
-        // exp2 is not available at the end of B, so is not generated
-        errs() << "PASS 3: Update GEN sets with KILL for each block\n";
-        for (unsigned i = 0; i < blockGenSetsAvail.size(); i++) { // For each block
-            errs() << "Updating GEN set for block " << i << "...\n";
-
-            for (unsigned j = 0; j < blockGenSetsAvail.at(i).size(); j++) { // For each GEN expression in block
-                Expression* genSetExpression = blockGenSetsAvail.at(i).at(j);
-                errs() << "  Checking GEN expression: ";
-                genSetExpression->print();
-
-                for (unsigned k = 0; k < blockKilledSetsAvail.at(i).size(); k++) { // For each KILL expression in block
-                    Expression* killedSetExpression = blockKilledSetsAvail.at(i).at(k);
-                    // If expression is in GEN and KILL and KILL comes after GEN, exp doesn't reach end of block
-                    if ((expsEqualWithoutIndex(*genSetExpression, *killedSetExpression)) && (genSetExpression->index < killedSetExpression->index)) {
-                        errs() << "    Deleted: ";
-                        genSetExpression->print();
-                        blockGenSetsAvail.at(i).at(j) = new Expression("", "", "", -1); // Set block's GEN exp to empty
+                    if (raw_ostream* out = writer.textAt(dataflow::Verbosity::Sets)) {
+                        *out << "This line can be optimized: Index " << instructionIndex << ": " << inst << "\n";
                     }
+                } else if (expNumber >= 0) {
+                    computations.push_back({&inst, unsigned(expNumber), instructionIndex, false});
+                    available.set(expNumber);
+                    computedHere[expNumber] = &inst;
                 }
             }
         }
+    }
 
-        // Clean GEN sets for each block (remove empty Expressions)
-        for (unsigned i = 0; i < blockGenSetsAvail.size(); i++) {
-            for (unsigned j = 0; j < blockGenSetsAvail.at(i).size(); j++) {
-                if (blockGenSetsAvail.at(i).at(j)->index == -1) {
-                    // Move this element to the last and then pop_back
-                    Expression* temp = blockGenSetsAvail.at(i).at(blockGenSetsAvail.at(i).size() - 1);
-                    blockGenSetsAvail.at(i).at(blockGenSetsAvail.at(i).size() - 1) = blockGenSetsAvail.at(i).at(j);
-                    blockGenSetsAvail.at(i).at(j) = temp;
-                    blockGenSetsAvail.at(i).pop_back();
-                }
+    vector<unsigned> reusedLines = {};
+    for (Computation& computation : computations) {
+        computation.reused = reusedAcross.test(computation.expression);
+        if (computation.reused) {
+            reusedLines.push_back(computation.index);
+        }
+    }
+
+    if (round == 0 || !redundancies.empty()) {
+        if (raw_ostream* out = writer.textAt(dataflow::Verbosity::Summary)) {
+            *out << "Redundant computations: ";
+            for (unsigned line : redundantLines) {
+                *out << line << ", ";
             }
+            *out << "\nComputations reused in other blocks: ";
+            for (unsigned line : reusedLines) {
+                *out << line << ", ";
+            }
+            *out << "\n";
         }
-        errs() << "\n";
+        writer.counter("cse", "redundant-computations", redundantLines.size());
+        writer.counter("cse", "reused-computations", reusedLines.size());
+    }
+    writer.flushTo(output);
 
-        blockNum = 0;
-        instructionIndex = 0;
+    if (redundancies.empty()) {
+        return false;
+    }
 
-        // PASS 4: Create IN and OUT sets for each block
-        errs() << "PASS 4: Create IN and OUT sets for each block\n";
-        for (auto& basic_block : F) { // Iterates over basic blocks of the function
-            vector<Expression*> currInSet = {};
-            vector<Expression*> currOutSet = {};
+    // PASS 6: Rewrite the IR
+    phases.start("cse-rewrite", "Rewrite the IR");
+    NumEliminated += redundancies.size();
+    SmallPtrSet<BasicBlock*, 16> edited;
+    eraseReplaced(replaceRedundancies(redundancies, computations, numExpressions, &edited), &edited);
+    for (BasicBlock* block : edited) {
+        changedBlocks.push_back(cfg.number(block));
+    }
+    llvm::sort(changedBlocks); // The set is ordered by address
+    return true;
+}
 
-            // Initial block has no IN set
-            if (blockNum == 0) {
-                currInSet = {};
-            }
-            // Current block's IN set is the intersection of its predecessors' OUTs
-            else {
-                unsigned predecessorIndex = 0;
-                for (auto* pred : predecessors(&basic_block)) {
-                    unsigned predBlockNum = 0;
-                    for (auto& predBlock : F) { // Find block number for predecessor
-                        if (&predBlock == pred) {
-                            break;
-                        }
-                        predBlockNum++;
-                    }
-                    // Start with all of the first predecessor's OUT expressions
-                    if (predecessorIndex == 0) {
-                        for (unsigned int i = 0; i < blockOutSetsAvail.at(predBlockNum).size(); i++) {
-                            currInSet.push_back(blockOutSetsAvail.at(predBlockNum).at(i));
-                        }
-                    } else {
-                        // First predecessor's OUTs must be in all other predecessors' OUTs
-                        for (unsigned int i = 0; i < currInSet.size(); i++) {
-                            bool isInAllPredecessors = false;
-                            for (unsigned int j = 0; j < blockOutSetsAvail.at(predBlockNum).size(); j++) {
-                                if (expsEqualWithoutIndex(*currInSet.at(i), *blockOutSetsAvail.at(predBlockNum).at(j))) {
-                                    isInAllPredecessors = true;
-                                    break;
-                                }
-                            }
-                            if (!isInAllPredecessors) {
-                                // Delete expression from currInSet
-                                // Send current expression to back, then pop
-                                Expression* temp = currInSet.at(i);
-                                currInSet.at(i) = currInSet.at(currInSet.size() - 1);
-                                currInSet.at(currInSet.size() - 1) = temp;
-                                currInSet.pop_back();
-                            }
-                        }
-                    }
-                    predecessorIndex++;
-                }
-            }
+// Fails unless the updated sets equal freshly computed ones
+void verifyUpdatedSets(Function& F, const dataflow::CFGIndex& cfg, const dataflow::AvailableExpressionSets& availableExprs,
+                       const dataflow::ReachingDefinitionSets& reachingDefs) {
+    dataflow::ResultWriter silent(dataflow::Verbosity::None, dataflow::OutputFormat::Text);
+    dataflow::AvailableExpressionSets freshExprs;
+    freshExprs.compute(F, cfg, silent);
+    dataflow::ReachingDefinitionSets freshDefs;
+    freshDefs.compute(F, cfg);
+    if (freshExprs.genSets != availableExprs.genSets || freshExprs.killSets != availableExprs.killSets ||
+        freshExprs.inSets != availableExprs.inSets || freshExprs.outSets != availableExprs.outSets) {
+        report_fatal_error("CSElimination: updated available expressions of " + F.getName() + " differ from a fresh computation");
+    }
+    if (freshDefs.genSets != reachingDefs.genSets || freshDefs.killSets != reachingDefs.killSets ||
+        freshDefs.inSets != reachingDefs.inSets || freshDefs.outSets != reachingDefs.outSets) {
+        report_fatal_error("CSElimination: updated reaching definitions of " + F.getName() + " differ from a fresh computation");
+    }
+}
 
-            // Update currKillSet to consider predecessors' OUT expressions
-            vector<Expression*> currKilledSet = blockKilledSetsAvail.at(blockNum); // Current block's KILL set
-            for (auto& inst : basic_block) {                                       // Iterates over instructions in a basic block
-                // Find statements A = ~ where A is an operand in this block's expressions
-                if (inst.getOpcode() == Instruction::Store) {
-                    string storeDestination = GetValueOperand(inst.getOperand(1), 1);
-                    errs() << "  Found A = B op C where A is \'" << storeDestination << "\'\n";
-
-                    // Check if an expression in this block used the same storeDestination as an IN's operand
-                    for (unsigned j = 0; j < currInSet.size(); j++) {
-                        Expression* inSetExpression = currInSet.at(j);
-                        errs() << "    Checking IN expression " << j << " in block " << blockNum << "...\n";
-
-                        // Does destination match either operand in this expression?
-                        if (storeDestination == inSetExpression->operand1 || storeDestination == inSetExpression->operand2) {
-                            errs() << "      Found match: ";
-                            inSetExpression->print();
-
-                            // Add the *killed* expression to this block's kill set
-                            // Index of the killed expression is where it was killed
-                            Expression* killedExp = new Expression(
-                                inSetExpression->operand1,
-                                inSetExpression->operand2,
-                                inSetExpression->opcode,
-                                instructionIndex);
-                            currKilledSet.push_back(killedExp);
-                        }
-                    }
-                }
-                instructionIndex++;
-            }
+// Runs rounds of eliminateCommonSubexpressions until one finds nothing to
+// replace. Replacing a computation can make another redundant, for example
+// when both operands of a later expression become the same value, so after
+// each round the instruction index and the sets are brought up to date for
+// just the blocks it edited. The CFG is unchanged throughout.
+bool eliminateToFixpoint(Function& F, const dataflow::CFGIndex& cfg, dataflow::InstructionIndex& instrs,
+                         dataflow::AvailableExpressionSets& availableExprs, dataflow::ReachingDefinitionSets& reachingDefs,
+                         dataflow::ResultWriter& writer, raw_ostream& output) {
+    bool changed = false;
+    SmallVector<unsigned, 16> changedBlocks;
+    for (unsigned round = 0;
+         eliminateCommonSubexpressions(F, cfg, instrs, availableExprs, reachingDefs, writer, output, round, changedBlocks);
+         round++) {
+        changed = true;
+        instrs.build(F);
+        availableExprs.update(F, cfg, changedBlocks);
+        reachingDefs.update(F, cfg, changedBlocks);
+        if (CSEVerifyUpdates) {
+            verifyUpdatedSets(F, cfg, availableExprs, reachingDefs);
+        }
+        changedBlocks.clear();
+    }
+    return changed;
+}
 
-            blockKilledSetsAvail.at(blockNum) = currKilledSet;
+// An expression computed in a dominating block: its value and the generation it was computed in
+struct ScopedValue {
+    Instruction* inst;
+    unsigned generation;
+};
 
-            // OUT = (IN - KILL) + GEN
-            // currOutSet = (currInSet - currKilledSet) + blockGenSets.at(blockNum);
+// Table entries come from a bump allocator owned by the walk, recycled as
+// scopes end and released in one go when the function is done
+using ExpressionTable = ScopedHashTable<unsigned, ScopedValue, DenseMapInfo<unsigned>,
+                                        RecyclingAllocator<BumpPtrAllocator, ScopedHashTableVal<unsigned, ScopedValue>>>;
+using KillTable = ScopedHashTable<const Value*, unsigned, DenseMapInfo<const Value*>,
+                                  RecyclingAllocator<BumpPtrAllocator, ScopedHashTableVal<const Value*, unsigned>>>;
+
+// One dominator tree node on the walk's stack, with the table scopes that
+// end when its subtree is done
+struct ScopedNode {
+    DomTreeNode* node;
+    DomTreeNode::const_iterator child;
+    ExpressionTable::ScopeTy expressionScope;
+    KillTable::ScopeTy killScope;
+    bool visited = false;
+
+    ScopedNode(DomTreeNode* node, ExpressionTable& expressions, KillTable& kills)
+        : node(node), child(node->begin()), expressionScope(expressions), killScope(kills) {}
+};
 
-            currOutSet = blockGenSetsAvail.at(blockNum);
-            vector<Expression*> inMinusKill = {};
+// Fast mode in the style of EarlyCSE: walks the dominator tree with a scoped
+// hash table of the expressions computed in the dominating blocks, and
+// replaces a computation whose expression is in the table and was not killed
+// since. No per-block sets are built.
+//
+// A store to a location records a new generation for it; an expression is
+// still valid when none of the variables it reads was stored to after it was
+// computed. Stores off the dominator chain only matter at a join, so on
+// entering a block with several predecessors the stores between it and its
+// immediate dominator are collected by walking back from the predecessors.
+bool eliminateDominatedSubexpressions(Function& F, const dataflow::CFGIndex& cfg, const dataflow::InstructionIndex& instrs,
+                                      DominatorTree& DT, dataflow::ResultWriter& writer, raw_ostream& output) {
+    dataflow::PhaseTimer phases("cse", "Common subexpression elimination", F.getName());
+    phases.start("cse-scoped", "Walk the dominator tree");
+
+    // Locations each block stores to
+    vector<SmallVector<const Value*, 4>> storedIn(cfg.size());
+    for (unsigned blockNum = 0; blockNum < cfg.size(); blockNum++) {
+        for (Instruction* inst : instrs.block(blockNum)) {
+            if (const auto* store = dyn_cast<StoreInst>(inst)) {
+                storedIn[blockNum].push_back(store->getPointerOperand());
+            }
+        }
+    }
 
-            // Find IN - KILL for current block
-            for (unsigned int i = 0; i < currInSet.size(); i++) {
-                bool shouldKill = false;
-                for (unsigned int j = 0; j < currKilledSet.size(); j++) {
-                    if (expsEqualWithoutIndex(*currInSet.at(i), *currKilledSet.at(j))) {
-                        shouldKill = true;
-                    }
+    ExpressionTable expressions;
+    KillTable kills;
+    unsigned generation = 1;
+    vector<unsigned> regionStamp(cfg.size(), 0); // Join (by block number + 1) whose region last visited a block
+    vector<unsigned> regionWorklist;
+    vector<unsigned> redundantLines = {};
+    vector<Instruction*> replaced;
+    dataflow::ValueNumbering numbering(F);
+
+    SmallVector<std::unique_ptr<ScopedNode>, 16> stack;
+    stack.push_back(std::make_unique<ScopedNode>(DT.getRootNode(), expressions, kills));
+    while (!stack.empty()) {
+        ScopedNode& top = *stack.back();
+        if (top.visited) {
+            if (top.child == top.node->end()) {
+                stack.pop_back(); // Leaves the node's scopes
+            } else {
+                DomTreeNode* child = *top.child++;
+                stack.push_back(std::make_unique<ScopedNode>(child, expressions, kills));
+            }
+            continue;
+        }
+        top.visited = true;
+        BasicBlock* block = top.node->getBlock();
+        unsigned blockNum = cfg.number(block);
+
+        // Stores on the paths from the immediate dominator into a join kill what they write
+        if (top.node->getIDom() && !block->getSinglePredecessor()) {
+            unsigned idomNum = cfg.number(top.node->getIDom()->getBlock());
+            generation++;
+            regionWorklist.assign(cfg.preds(blockNum).begin(), cfg.preds(blockNum).end());
+            while (!regionWorklist.empty()) {
+                unsigned pred = regionWorklist.back();
+                regionWorklist.pop_back();
+                if (pred == idomNum || regionStamp[pred] == blockNum + 1 || !cfg.isReachable(pred)) {
+                    continue;
                 }
-                // Save expressions in IN that are not in KILL
-                if (!shouldKill) {
-                    inMinusKill.push_back(currInSet.at(i));
+                regionStamp[pred] = blockNum + 1;
+                for (const Value* location : storedIn[pred]) {
+                    kills.insert(location, generation);
                 }
+                regionWorklist.insert(regionWorklist.end(), cfg.preds(pred).begin(), cfg.preds(pred).end());
             }
+        }
 
-            // Find GEN + (IN - KILL)
-            for (unsigned int i = 0; i < inMinusKill.size(); i++) {
-                bool alreadyExists = false;
-                for (unsigned int j = 0; j < currOutSet.size(); j++) {
-                    if (inMinusKill.at(i) == currOutSet.at(j)) {
-                        alreadyExists = true;
-                    }
-                }
-                if (!alreadyExists) {
-                    currOutSet.push_back(inMinusKill.at(i));
+        for (unsigned index = instrs.blockStart[blockNum]; index < instrs.blockStart[blockNum + 1]; index++) {
+            Instruction& inst = *instrs.at(index);
+            if (const auto* store = dyn_cast<StoreInst>(&inst)) {
+                kills.insert(store->getPointerOperand(), ++generation);
+                continue;
+            }
+            int number = numbering.numberOf(inst);
+            if (number < 0) {
+                continue;
+            }
+            ScopedValue available = expressions.lookup(number);
+            auto killedSince = [&](const Value* location) { return kills.lookup(location) > available.generation; };
+            ArrayRef<const Value*> reads = numbering.locationsRead(number);
+            if (available.inst && std::none_of(reads.begin(), reads.end(), killedSince)) {
+                DATAFLOW_TRACE(writer, "  Index " << index << " is redundant\n");
+                if (raw_ostream* out = writer.textAt(dataflow::Verbosity::Sets)) {
+                    *out << "This line can be optimized: Index " << index << ": " << inst << "\n";
                 }
+                redundantLines.push_back(index);
+                available.inst->andIRFlags(&inst);
+                inst.replaceAllUsesWith(available.inst);
+                replaced.push_back(&inst);
+            } else {
+                expressions.insert(number, {&inst, generation});
             }
-
-            // Add IN and OUT sets for the current block
-            blockInSetsAvail.push_back(currInSet);
-            blockOutSetsAvail.push_back(currOutSet);
-            blockNum++;
         }
+    }
+    // Erased only now, as the table may still hold an operand of a replaced computation
+    phases.start("cse-rewrite", "Rewrite the IR");
+    eraseReplaced(replaced);
+    phases.stop();
+    NumBlocks += cfg.size();
+    NumExpressions += numbering.size();
+    NumEliminated += replaced.size();
+
+    if (raw_ostream* out = writer.textAt(dataflow::Verbosity::Summary)) {
+        std::sort(redundantLines.begin(), redundantLines.end());
+        *out << "Redundant computations: ";
+        for (unsigned line : redundantLines) {
+            *out << line << ", ";
+        }
+        *out << "\n";
+    }
+    writer.counter("cse", "redundant-computations", redundantLines.size());
+    writer.flushTo(output);
+    return !replaced.empty();
+}
 
-        // ===============================
-        //    FIND REACHING DEFINITIONS
-        // ===============================
-
-        errs() << "\nFinding Reaching Definitions for function: " << F.getName();
-
-        vector<unsigned> storeInstructionIndices;
-        vector<Value*> storeInstructionDestVars;
-        unsigned instrIndex = 0;
-        blockNum = 0;
+// Partial redundancy elimination by lazy code motion. Critical edges are
+// split so every edge has a block to insert on; the edge blocks nothing was
+// placed in are folded away again at the end.
+//
+// A computation whose expression reaches it from placements on every path
+// takes the value of the placements and the computations that stay, joined by
+// phis. Within a block, a computation repeating one that was not killed since
+// reuses its value directly, for every expression.
+bool eliminatePartialRedundancies(Function& F, dataflow::ResultWriter& writer, raw_ostream& output) {
+    dataflow::PhaseTimer phases("cse", "Common subexpression elimination", F.getName());
+    phases.start("cse-split-edges", "Split critical edges");
+
+    // Reports number the instructions of the function as it came in
+    dataflow::InstructionIndex originalInstrs(F);
+
+    SmallVector<Instruction*, 16> terminators;
+    for (auto& basic_block : F) {
+        if (basic_block.getTerminator() && basic_block.getTerminator()->getNumSuccessors() > 1) {
+            terminators.push_back(basic_block.getTerminator());
+        }
+    }
+    SmallVector<BasicBlock*, 16> edgeBlocks;
+    for (Instruction* terminator : terminators) {
+        for (unsigned succ = 0; succ < terminator->getNumSuccessors(); succ++) {
+            if (BasicBlock* edgeBlock = SplitCriticalEdge(terminator, succ)) {
+                edgeBlocks.push_back(edgeBlock);
+            }
+        }
+    }
 
-        // First Pass: Get all of the indexes and destination variables of the store instructions
-        for (auto& basic_block : F) {        // Iterates over basic blocks of the function
-            for (auto& inst : basic_block) { // Iterates over instructions in a basic block
-                if (inst.getOpcode() == Instruction::Store) {
-                    Value* storeDestination = inst.getOperand(1);
-                    storeInstructionIndices.push_back(instrIndex);
-                    storeInstructionDestVars.push_back(storeDestination);
+    phases.start("cse-numbering", "Number the expressions");
+    dataflow::CFGIndex cfg(F);
+    dataflow::InstructionIndex instrs(F);
+    dataflow::ValueNumbering numbering(F);
+    phases.stop();
+    dataflow::LazyCodeMotionSets lcm;
+    lcm.compute(cfg, numbering, writer);
+    if (raw_ostream* out = writer.textAt(dataflow::Verbosity::Summary)) {
+        *out << "Lazy code motion converged after " << lcm.iterations << " block visits\n";
+    }
+    writer.counter("lazy-code-motion", "block-visits", lcm.iterations);
+
+    // PASS 6: Find the computations placements or earlier computations make redundant
+    DATAFLOW_TRACE(writer, "PASS 6: Find redundant computations\n");
+    phases.start("cse-find", "Find redundant computations");
+    unsigned numExpressions = numbering.size();
+    vector<unsigned> redundantLines = {};
+    vector<Redundancy> redundancies = {};
+    vector<Computation> computations = {};
+    DenseMap<unsigned, Instruction*> computedHere; // Expression -> its computation in this block since it was last killed
+    BitVector killed(numExpressions);
+    for (unsigned blockNum = 0; blockNum < cfg.size(); blockNum++) {
+        computedHere.clear();
+        killed.reset();
+        for (Instruction* inst : instrs.block(blockNum)) {
+            if (const auto* store = dyn_cast<StoreInst>(inst)) {
+                for (unsigned number : numbering.expressionsReading(store->getPointerOperand())) {
+                    computedHere.erase(number);
+                    killed.set(number);
                 }
-                instrIndex++;
+                continue;
+            }
+            if (!inst->willReturn()) {
+                killed |= lcm.trapping;
             }
-            blockNum++;
+            int number = numbering.numberOf(*inst);
+            if (number < 0) {
+                continue;
+            }
+            Instruction* earlier = computedHere.lookup(number);
+            bool fromOtherBlocks = !earlier && !killed.test(number) && lcm.useSets[blockNum].test(number) &&
+                                   !lcm.latest[blockNum].test(number);
+            computedHere.insert({unsigned(number), inst});
+            if (!earlier && !fromOtherBlocks) {
+                bool reused = lcm.candidates.test(number) && lcm.usedOut[blockNum].test(number);
+                computations.push_back({inst, unsigned(number), originalInstrs.indexOf(inst), reused});
+                continue;
+            }
+            DATAFLOW_TRACE(writer, "  Index " << originalInstrs.indexOf(inst) << " is redundant, value from "
+                                              << (earlier ? "this block" : "other blocks") << "\n");
+            if (raw_ostream* out = writer.textAt(dataflow::Verbosity::Sets)) {
+                *out << "This line can be optimized: Index " << originalInstrs.indexOf(inst) << ": " << *inst << "\n";
+            }
+            redundantLines.push_back(originalInstrs.indexOf(inst));
+            redundancies.push_back({inst, unsigned(number), earlier});
         }
+    }
 
-        instrIndex = 0;
-        blockNum = 0;
-        vector<vector<unsigned>> blockGenSetsReach = {};
-        vector<vector<unsigned>> blockKillSetsReach = {};
-
-        // Second Pass: Add to GEN and KILL sets
-        for (auto& basic_block : F) { // Iterates over basic blocks of the function
-            vector<vector<unsigned>> GEN_KILLSETS = {};
-            vector<unsigned> GEN = {};
-            vector<unsigned> KILL = {};
-
-            for (auto& inst : basic_block) { // Iterates over instructions in a basic block
-                if (inst.getOpcode() == Instruction::Store) {
-                    GEN.push_back(instrIndex); // Each store instruction is a GEN
-                    Value* storeDestination = inst.getOperand(1);
-
-                    // Find other instructions that change the same variable; add them to block's KILL
-                    for (unsigned int i = 0; i < storeInstructionDestVars.size(); i++) {
-                        if ((storeInstructionDestVars.at(i) == storeDestination) && (storeInstructionIndices.at(i) != instrIndex)) {
-                            KILL.push_back(storeInstructionIndices.at(i));
-                        }
-                    }
+    // PASS 7: Place the expressions at the end of their latest blocks, where no upward-exposed
+    // computation stands in for them. Nothing in such a block kills them, so the value is the
+    // one the block starts with.
+    DATAFLOW_TRACE(writer, "PASS 7: Insert computations\n");
+    phases.start("cse-insert", "Insert computations");
+    unsigned inserted = 0;
+    BitVector placements(numExpressions);
+    for (unsigned blockNum = 0; blockNum < cfg.size(); blockNum++) {
+        placements = lcm.latest[blockNum];
+        placements &= lcm.usedOut[blockNum];
+        placements.reset(lcm.useSets[blockNum]);
+        for (unsigned number : placements.set_bits()) {
+            Instruction* placement = materialize(numbering, number, cfg.blocks[blockNum]->getTerminator());
+            computations.push_back({placement, number, ~0U, true});
+            inserted++;
+            if (raw_ostream* out = writer.textAt(dataflow::Verbosity::Sets)) {
+                BasicBlock* block = cfg.blocks[blockNum];
+                *out << "Inserted ";
+                numbering.print(*out, number);
+                if (block->getSinglePredecessor() && is_contained(edgeBlocks, block)) {
+                    *out << " on the edge " << dataflow::AsOperand(block->getSinglePredecessor()) << " -> "
+                         << dataflow::AsOperand(block->getSingleSuccessor()) << "\n";
+                } else {
+                    *out << " at the end of " << dataflow::AsOperand(block) << "\n";
                 }
-                instrIndex++;
             }
-            blockGenSetsReach.push_back(GEN);
-            blockKillSetsReach.push_back(KILL);
-            blockNum++;
         }
+    }
+    phases.start("cse-rewrite", "Rewrite the IR");
+    if (!redundancies.empty()) {
+        eraseReplaced(replaceRedundancies(redundancies, computations, numExpressions));
+    }
+
+    // Edge blocks nothing was placed in go away again
+    for (BasicBlock* edgeBlock : edgeBlocks) {
+        if (edgeBlock->size() == 1) {
+            TryToSimplifyUncondBranchFromEmptyBlock(edgeBlock);
+        }
+    }
+    phases.stop();
+    NumBlocks += cfg.size();
+    NumExpressions += numExpressions;
+    NumSolverVisits += lcm.iterations;
+    NumEliminated += redundancies.size();
+    NumInserted += inserted;
+
+    if (raw_ostream* out = writer.textAt(dataflow::Verbosity::Summary)) {
+        std::sort(redundantLines.begin(), redundantLines.end());
+        *out << "Redundant computations: ";
+        for (unsigned line : redundantLines) {
+            *out << line << ", ";
+        }
+        *out << "\nComputations inserted: " << inserted << "\n";
+    }
+    writer.counter("cse", "redundant-computations", redundantLines.size());
+    writer.counter("cse", "inserted-computations", inserted);
+    writer.flushTo(output);
+    return !redundancies.empty() || inserted > 0;
+}
+
+// The value a tracked variable holds right after a load or store of it
+struct KnownValue {
+    Instruction* at;
+    Value* value;
+};
 
-        vector<unsigned> setTemp = {};
-        vector<vector<unsigned>> blockInSetsReach(blockNum, setTemp);
-        vector<vector<unsigned>> blockOutSetsReach(blockNum, setTemp);
+using ValueTable = ScopedHashTable<const Value*, KnownValue, DenseMapInfo<const Value*>,
+                                   RecyclingAllocator<BumpPtrAllocator, ScopedHashTableVal<const Value*, KnownValue>>>;
 
-        instrIndex = 0;
-        blockNum = 0;
+// One dominator tree node on the load walk's stack, with the table scope that
+// ends when its subtree is done
+struct LoadScopeNode {
+    DomTreeNode* node;
+    DomTreeNode::const_iterator child;
+    ValueTable::ScopeTy scope;
+    bool visited = false;
 
-        // Create the IN and OUT set for each block
-        for (auto& basic_block : F) {
-            vector<unsigned> IN = {};
-            vector<unsigned> OUT = {};
+    LoadScopeNode(DomTreeNode* node, ValueTable& values) : node(node), child(node->begin()), scope(values) {}
+};
 
-            // Initial block has no IN
-            if (blockNum == 0) {
-                IN = {};
+// Redundant load elimination on the reaching definitions. Walks the dominator
+// tree with the last load or store of each tracked variable in the dominating
+// blocks, and replaces a load by the value read or written there when every
+// definition of the variable reaching the load dominates that point, or the
+// load is on a straight path from it. Either way no store on a path between
+// the two can have changed the variable. A load a
+// single dominating store reaches takes the stored value (store-to-load
+// forwarding); one after an earlier load takes the loaded value.
+//
+// The reaching definitions must be those of F as it is now. Loads removed by
+// an earlier pass do not change them, as long as no store was added or removed.
+bool eliminateRedundantLoads(Function& F, const dataflow::CFGIndex& cfg,
+                             const dataflow::ReachingDefinitionSets& reachingDefs, DominatorTree& DT,
+                             dataflow::ResultWriter& writer, raw_ostream& output) {
+    dataflow::PhaseTimer phases("cse", "Common subexpression elimination", F.getName());
+    phases.start("cse-loads", "Eliminate redundant loads");
+    DenseMap<const Value*, bool> trackedVariables;
+    auto isTracked = [&](const Value* pointer) {
+        auto inserted = trackedVariables.insert({pointer, false});
+        if (inserted.second) {
+            const auto* alloca = dyn_cast<AllocaInst>(pointer);
+            inserted.first->second = alloca && dataflow::isTrackedVariable(*alloca);
+        }
+        return inserted.first->second;
+    };
+
+    ValueTable values;
+    // Block number -> first block of the single-predecessor chain it ends, which dominates it
+    vector<unsigned> chainStart(cfg.size(), 0);
+    BitVector reaching;
+    vector<Instruction*> replaced;
+    unsigned forwarded = 0;
+
+    SmallVector<std::unique_ptr<LoadScopeNode>, 16> stack;
+    stack.push_back(std::make_unique<LoadScopeNode>(DT.getRootNode(), values));
+    while (!stack.empty()) {
+        LoadScopeNode& top = *stack.back();
+        if (top.visited) {
+            if (top.child == top.node->end()) {
+                stack.pop_back(); // Leaves the node's scope
             } else {
-                // Use the block's predecessors for IN
-                for (auto* pred : predecessors(&basic_block)) {
-                    unsigned predBlockNum = 0;
-                    for (auto& funcBlock : F) {
-                        // Find block number for predecessor
-                        if (&funcBlock == pred) {
-                            break;
-                        }
-                        predBlockNum++;
-                    }
-                    // IN is the OUT of the predecessor
-                    for (unsigned int i = 0; i < blockOutSetsReach.at(predBlockNum).size(); i++) {
-                        IN.push_back(blockOutSetsReach.at(predBlockNum).at(i));
-                    }
+                DomTreeNode* child = *top.child++;
+                stack.push_back(std::make_unique<LoadScopeNode>(child, values));
+            }
+            continue;
+        }
+        top.visited = true;
+        BasicBlock* block = top.node->getBlock();
+        unsigned blockNum = cfg.number(block);
+        const BasicBlock* pred = block->getSinglePredecessor();
+        chainStart[blockNum] = pred ? chainStart[cfg.number(pred)] : blockNum;
+
+        for (auto& inst : *block) {
+            if (auto* store = dyn_cast<StoreInst>(&inst)) {
+                if (isTracked(store->getPointerOperand())) {
+                    values.insert(store->getPointerOperand(), {store, store->getValueOperand()});
                 }
+                continue;
             }
-
-            // Convert GEN, KILL, IN, OUT to sets to sort and remove duplicates
-            set<unsigned> currGen(blockGenSetsReach.at(blockNum).begin(), blockGenSetsReach.at(blockNum).end());
-            set<unsigned> currKill(blockKillSetsReach.at(blockNum).begin(), blockKillSetsReach.at(blockNum).end());
-            set<unsigned> currIn(IN.begin(), IN.end());
-            set<unsigned> currOut(OUT.begin(), OUT.end());
-
-            // OUT = (IN - KILL) + GEN; result is stored in currOut
-            set_difference(currIn.begin(), currIn.end(), currKill.begin(), currKill.end(), inserter(currOut, currOut.begin()));
-            set_union(currGen.begin(), currGen.end(), currOut.begin(), currOut.end(), inserter(currOut, currOut.begin()));
-
-            // Turn OUT back into a vector
-            vector<unsigned> temp(currOut.begin(), currOut.end());
-            OUT = temp;
-
-            // Update IN and OUT for the block
-            blockInSetsReach.at(blockNum) = IN;
-            blockOutSetsReach.at(blockNum) = OUT;
-
-            blockNum++;
-        }
-
-        // Print IN, OUT, GEN, KILL for each block's reaching definitions
-        for (unsigned int i = 0; i < blockGenSetsReach.size(); ++i) {
-            errs() << "\nBlock " << i << " reaching definitions:";
-            errs() << "\n  IN: ";
-            blockInSetsReach.at(i) = sortAndRemoveDuplicates(blockInSetsReach.at(i));
-            for (unsigned int j = 0; j < blockInSetsReach.at(i).size(); ++j) {
-                errs() << blockInSetsReach.at(i).at(j) << " ";
-            }
-            errs() << "\n  GEN: ";
-            blockGenSetsReach.at(i) = sortAndRemoveDuplicates(blockGenSetsReach.at(i));
-            for (unsigned int m = 0; m < blockGenSetsReach.at(i).size(); ++m) {
-                errs() << blockGenSetsReach.at(i).at(m) << " ";
-            }
-            errs() << "\n  KILL: ";
-            blockKillSetsReach.at(i) = sortAndRemoveDuplicates(blockKillSetsReach.at(i));
-            for (unsigned int n = 0; n < blockKillSetsReach.at(i).size(); ++n) {
-                errs() << blockKillSetsReach.at(i).at(n) << " ";
-            }
-            errs() << "\n  OUT: ";
-            blockOutSetsReach.at(i) = sortAndRemoveDuplicates(blockOutSetsReach.at(i));
-            for (unsigned int k = 0; k < blockOutSetsReach.at(i).size(); ++k) {
-                errs() << blockOutSetsReach.at(i).at(k) << " ";
-            }
-            errs() << "\n";
-        }
-
-        // ===============================
-        //    END REACHING DEFINITIONS
-        // ===============================
-
-        // Print all IN, GEN, KILL, and OUT sets for every block's available expressions
-        errs() << "\nAvailable Expressions for each block:";
-        for (unsigned i = 0; i < blockInSetsAvail.size(); ++i) {
-            errs() << "\nBlock " << i << " available expressions:";
-            errs() << "\n  IN:\n";
-            for (unsigned j = 0; j < blockInSetsAvail.at(i).size(); ++j) {
-                errs() << "    ";
-                blockInSetsAvail.at(i).at(j)->print();
-            }
-            errs() << "  GEN:\n";
-            for (unsigned j = 0; j < blockGenSetsAvail.at(i).size(); ++j) {
-                errs() << "    ";
-                blockGenSetsAvail.at(i).at(j)->print();
-            }
-            errs() << "  KILL:\n";
-            for (unsigned j = 0; j < blockKilledSetsAvail.at(i).size(); ++j) {
-                errs() << "    ";
-                blockKilledSetsAvail.at(i).at(j)->print();
-            }
-            errs() << "  OUT:\n";
-            for (unsigned j = 0; j < blockOutSetsAvail.at(i).size(); ++j) {
-                errs() << "    ";
-                blockOutSetsAvail.at(i).at(j)->print();
-            }
-        }
-        errs() << "\n";
-
-        blockNum = 0;
-        instructionIndex = 0;
-
-        // PASS 5: transformation for CSElimination
-        errs() << "PASS 5: Transform for CSElimination\n";
-        vector<unsigned int> linesToSetTemp = {};
-        vector<unsigned int> linesThatUseTemp = {};
-        for (auto& basic_block : F) {
-            for (auto& inst : basic_block) {
-                // If statement is A = B op C in block S
-                if (inst.getOpcode() == Instruction::Add || inst.getOpcode() == Instruction::Sub || inst.getOpcode() == Instruction::Mul || inst.getOpcode() == Instruction::SDiv) {
-                    Value* op1 = inst.getOperand(0);
-                    Value* op2 = inst.getOperand(1);
-
-                    // Both operands should look like '%22 = load i32, i32* %2, align 4'
-                    // If either operand is NOT a load, it's an immediate; ignore those
-                    if (isa<LoadInst>(op1) && isa<LoadInst>(op2)) {
-                        // Save the expression
-                        Expression* exp = new Expression(op1, op2, inst.getOpcode(), instructionIndex);
-
-                        bool expIsAvailableAtEntry = false;
-                        unsigned int availIndex = 0;
-                        string availDestination = "";
-                        vector<string> availDestinations = {};
-
-                        // Is the expression available at entry of this block?
-                        for (unsigned i = 0; i < blockInSetsAvail.at(blockNum).size(); ++i) {
-                            if (expsEqualWithoutIndex(*exp, *blockInSetsAvail.at(blockNum).at(i))) {
-                                linesThatUseTemp.push_back(instructionIndex);
-                                expIsAvailableAtEntry = true;
-                                availIndex = blockInSetsAvail.at(blockNum).at(i)->index; // Save expression's index
-
-                                // Find the IR instruction corresponding to the expression
-                                unsigned innerInstrIndex = 0;
-                                for (auto& basic_block : F) {
-                                    for (auto& inst : basic_block) {
-                                        if (innerInstrIndex == availIndex) {
-                                            // Save the expression's destination
-                                            // Represents RHS, e.g. dest = B op C
-                                            availDestination = GetInstrDestination(inst, 1);
-                                            availDestinations.push_back(availDestination);
-                                        }
-                                        innerInstrIndex++;
-                                    }
-                                }
-                                break;
-                            }
-                        }
-
-                        if (expIsAvailableAtEntry) {
-                            // Indices of definitions that reach our block
-                            vector<unsigned> defsReachingBlock = blockInSetsReach.at(blockNum);
-                            // Find the IR instruction for each definition that reaches our block
-                            for (unsigned i = 0; i < defsReachingBlock.size(); ++i) {
-                                unsigned innerInstrIndex = 0;
-                                for (auto& basic_block : F) {
-                                    for (auto& inst : basic_block) {
-                                        if (innerInstrIndex == defsReachingBlock.at(i)) {
-                                            // Destination for reaching def, represents B op C
-                                            string reachingValue = GetInstrDestination(inst, 2);
-                                            for (unsigned int i = 0; i < availDestinations.size(); i++) {
-                                                // Does the reaching def use B op C like our available expression?
-                                                if (reachingValue == availDestinations.at(i)) {
-                                                    errs() << "This line can be optimized: Index " << innerInstrIndex << ": " << inst << "\n";
-                                                    linesToSetTemp.push_back(innerInstrIndex);
-                                                }
-                                            }
-                                        }
-                                        innerInstrIndex++;
-                                    }
-                                }
-                            }
-                        }
-                    } else {
-                        errs() << "  Found A = B op C, but A or B is an immediate value.\n";
+            auto* load = dyn_cast<LoadInst>(&inst);
+            if (!load || !isTracked(load->getPointerOperand())) {
+                continue;
+            }
+            const Value* variable = load->getPointerOperand();
+            KnownValue known = values.lookup(variable);
+            bool redundant = known.at && known.value->getType() == load->getType();
+            // On a straight path from the known value nothing can store in between, or
+            // the table would hold that store instead
+            unsigned variableNum = reachingDefs.variableOf(variable);
+            if (redundant && variableNum != ~0U &&
+                chainStart[cfg.number(known.at->getParent())] != chainStart[blockNum]) {
+                reaching = reachingDefs.inSets[blockNum];
+                reaching &= reachingDefs.variableMasks[variableNum];
+                for (unsigned defIndex : reaching.set_bits()) {
+                    StoreInst* definition = reachingDefs.definitions[defIndex];
+                    if (definition != known.at && !DT.dominates(definition, known.at)) {
+                        redundant = false;
+                        break;
                     }
                 }
-                instructionIndex++;
             }
-            blockNum++;
-        }
-
-        // Print out the lines that need to be replaced with store and load temp variables
-        errs() << "Lines to replace with two lines: ";
-        for (unsigned int i = 0; i < linesToSetTemp.size(); i++) {
-            errs() << linesToSetTemp.at(i) << ", ";
-        }
-
-        // Print out the lines that need to be replaced since they use temp now
-        errs() << "\nLines to replace with one line: ";
-        for (unsigned int i = 0; i < linesThatUseTemp.size(); i++) {
-            errs() << linesThatUseTemp.at(i) << ", ";
+            if (!redundant) {
+                values.insert(variable, {load, load});
+                continue;
+            }
+            DATAFLOW_TRACE(writer, "  " << *load << " reads a known value\n");
+            if (raw_ostream* out = writer.textAt(dataflow::Verbosity::Sets)) {
+                *out << "This load can be removed: " << *load << "\n";
+            }
+            if (isa<StoreInst>(known.at)) {
+                forwarded++;
+            }
+            load->replaceAllUsesWith(known.value);
+            values.insert(variable, {load, known.value});
+            replaced.push_back(load);
         }
+    }
+    // Erased only now, as the table may still point at a replaced load
+    for (Instruction* load : replaced) {
+        load->eraseFromParent();
+    }
+    phases.stop();
+    NumLoadsEliminated += replaced.size();
+    NumStoresForwarded += forwarded;
 
-        // PASS 6: Print out the optimized IR code
-        errs() << "\n\nWriting optimized IR code to optimizedCode.txt...\n";
+    if (raw_ostream* out = writer.textAt(dataflow::Verbosity::Summary)) {
+        *out << "Redundant loads: " << replaced.size() << ", forwarded from stores: " << forwarded << "\n";
+    }
+    writer.counter("cse", "redundant-loads", replaced.size());
+    writer.counter("cse", "forwarded-stores", forwarded);
+    writer.flushTo(output);
+    return !replaced.empty();
+}
 
-        // Keep the instruction index and define the name of the output text file
-        unsigned innerInstrIndex = 0;
-        ofstream outputFile("optimizedCode.txt");
+struct CSElimination : public FunctionPass {
+    static char ID;
+    CSElimination() : FunctionPass(ID) {}
 
-        // Output %tmp variables, and increase line number by 1 for lines that we update due to temp
-        for (unsigned int i = 0; i < linesToSetTemp.size(); i++) {
-            outputFile << "  %tmp" << i << " = alloca i32, align 4\n";
-            linesToSetTemp = AddNumToVectorElements(linesToSetTemp, 1);
-            linesThatUseTemp = AddNumToVectorElements(linesThatUseTemp, 1);
-            innerInstrIndex++;
+    bool doInitialization(Module& M) override {
+        if (Error error = output.open(CSEOutput, CSEFormat)) {
+            M.getContext().emitError("-cse-output: " + toString(std::move(error)));
         }
+        return false;
+    }
 
-        // Output each line of instruction including the new temp instructions
-        int lineChangedXTimes = 0;
-        int currRegisterNum = 0;
-        for (auto& basic_block : F) {
-            for (auto& instr : basic_block) {
-                // Change the instruction to a string
-                string temp = "";
-                raw_string_ostream stream(temp);
-                instr.print(stream);
-                string instrString = stream.str();
-
-                // Keep a bool for whether the line was already changed due to temp
-                bool alreadyChangedLine = false;
-
-                // Look through the vector that holds the line number we want to change and see if we are that instruction (for creation)
-                for (unsigned int i = 0; i < linesToSetTemp.size(); i++) {
-                    if (linesToSetTemp.at(i) == innerInstrIndex) {
-                        // Create a store instruction that uses tmp and replace the current instruction
-                        // ex: store i32 %add, i32* %tmp, align 4
-                        unsigned instrStringPercentIndex = instrString.find("%", 13);
-                        unsigned instrStringCommaIndex = instrString.find(",", instrStringPercentIndex);
-                        instrString.replace(instrStringPercentIndex, instrStringCommaIndex - instrStringPercentIndex, "%tmp" + to_string(i));
-                        outputFile << instrString << "\n";
+    bool doFinalization(Module& M) override {
+        output.close();
+        return false;
+    }
 
-                        // Create a load instruction to load tmp to a register and add a new instruction
-                        // ex: %6 = load i32, i32* %tmp, align 4
-                        outputFile << "  %" << ++currRegisterNum << " = load i32, i32* %tmp" << to_string(i) << ", align 4\n";
+    bool runOnFunction(Function& F) override {
+        dataflow::ResultWriter writer(CSEVerbosity, CSEFormat);
+        writer.function(F.getName());
+        dataflow::PhaseProfile profile(CSEPerfCounters, writer, output.stream());
+
+        if (CSEMode == CSEEngine::PartialRedundancy) {
+            bool changed = eliminatePartialRedundancies(F, writer, output.stream());
+            if (CSELoads) {
+                // The blocks may have changed, so nothing of the pass manager's is used
+                dataflow::CFGIndex cfg(F);
+                dataflow::ReachingDefinitionSets reachingDefs;
+                reachingDefs.compute(F, cfg);
+                DominatorTree DT(F);
+                changed |= eliminateRedundantLoads(F, cfg, reachingDefs, DT, writer, output.stream());
+            }
+            return changed;
+        }
+        // Block numbers and predecessor/successor indices shared by every pass below
+        dataflow::CFGIndex cfg(F);
+        dataflow::InstructionIndex instrs(F);
+        DominatorTree& DT = getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+        dataflow::ReachingDefinitionSets reachingDefs;
+        bool changed = false;
+        if (CSEMode == CSEEngine::Scoped) {
+            changed = eliminateDominatedSubexpressions(F, cfg, instrs, DT, writer, output.stream());
+            if (CSELoads) {
+                reachingDefs.compute(F, cfg);
+            }
+        } else {
+            dataflow::AvailableExpressionSets availableExprs;
+            availableExprs.compute(F, cfg, writer);
+            reachingDefs.compute(F, cfg);
+            changed = eliminateToFixpoint(F, cfg, instrs, availableExprs, reachingDefs, writer, output.stream());
+        }
+        // Common subexpression elimination leaves the stores alone, so the reaching definitions still hold
+        if (CSELoads) {
+            changed |= eliminateRedundantLoads(F, cfg, reachingDefs, DT, writer, output.stream());
+        }
+        return changed;
+    }
 
-                        // The number of lines have increased in the file
-                        lineChangedXTimes++;
-                        alreadyChangedLine = true;
-                        break;
-                    }
-                }
+    // Only non-terminator instructions are added and removed, except that lazy
+    // code motion keeps the edge blocks it inserts into
+    void getAnalysisUsage(AnalysisUsage& AU) const override {
+        AU.addRequired<DominatorTreeWrapperPass>();
+        if (CSEMode != CSEEngine::PartialRedundancy) {
+            AU.setPreservesCFG();
+        }
+    }
 
-                // Look through the vector that holds the line number we want to change and see if we are that instruction (for uses)
-                for (unsigned int i = 0; i < linesThatUseTemp.size(); i++) {
-                    if (linesThatUseTemp.at(i) == innerInstrIndex) {
-                        // Look for the register number in the current instruction
-                        // ex: %10 = add nsw i32 %8, %9, isolate 10
-                        unsigned instrStringPercentIndex = instrString.find("%", 0);
-                        unsigned instrStringCommaIndex = instrString.find(" =", instrStringPercentIndex);
-                        int replaceNum = stoi(instrString.substr(instrStringPercentIndex + 1, instrStringCommaIndex - instrStringPercentIndex));
-
-                        // Create a new instruction that loads temp instead of recomputing the add, sub, mult, or div expression and replace the current instruction
-                        // ex: %10 = load i32, i32* %tmp, align 4
-                        instrString = "  %" + to_string(replaceNum + lineChangedXTimes) + " = load i32, i32* " + "%tmp" + to_string(i) + ", align 4";
-                        outputFile << instrString << "\n";
-                        alreadyChangedLine = true;
-                        break;
-                    }
-                }
+private:
+    dataflow::ResultOutput output;
+}; // end of struct CSElimination
 
-                // If the line was already changed due to temp, then skip this step, otherwise continue
-                // Online look at load, alloc, add, sub, mult, sdiv, or comparison instruction (skip break for now)
-                if (!alreadyChangedLine && lineChangedXTimes > 0 && (isa<LoadInst>(instr) || isa<AllocaInst>(instr) || isa<BinaryOperator>(instr) || isa<ICmpInst>(instr))) {
-                    // Find the current register number
-                    unsigned instrStringPercentIndex = instrString.find("%", 0);
-                    unsigned instrStringCommaIndex = instrString.find(" =", instrStringPercentIndex);
-                    currRegisterNum = stoi(instrString.substr(instrStringPercentIndex + 1, instrStringCommaIndex - instrStringPercentIndex));
-
-                    // Replace the current line's register number to an updated register number since temp used some before this
-                    instrStringPercentIndex = instrString.find("%", 0);
-                    instrStringCommaIndex = instrString.find(" =", instrStringPercentIndex);
-                    instrString.replace(instrStringPercentIndex, instrStringCommaIndex - instrStringPercentIndex, "%" + to_string(currRegisterNum + lineChangedXTimes));
-
-                    // If it is a comparison instruction, then we want to do more
-                    if (isa<ICmpInst>(instr)) {
-                        // Save the register number that we are going to compare to
-                        instrStringPercentIndex = instrString.find("%", 20);
-                        instrStringCommaIndex = instrString.find(", ", instrStringPercentIndex);
-                        int comparisonNum = stoi(instrString.substr(instrStringPercentIndex + 1, instrStringCommaIndex - instrStringPercentIndex));
-
-                        // Update the string with the correct register number
-                        instrStringPercentIndex = instrString.find("%", 20);
-                        instrStringCommaIndex = instrString.find(", ", instrStringPercentIndex);
-                        instrString.replace(instrStringPercentIndex, instrStringCommaIndex - instrStringPercentIndex, "%" + to_string(comparisonNum + lineChangedXTimes));
-                    }
+// New pass manager version: takes the reaching definitions and available
+// expressions cached in the FunctionAnalysisManager instead of computing its own
+struct CSEliminationPass : public PassInfoMixin<CSEliminationPass> {
+    CSEliminationPass() : output(std::make_shared<dataflow::ResultOutput>()) {
+        if (Error error = output->open(CSEOutput, CSEFormat)) {
+            openError = "-cse-output: " + toString(std::move(error));
+        }
+    }
 
-                    outputFile << instrString << "\n";
+    // Run on optnone functions too (clang -O0 output marks every function optnone)
+    static bool isRequired() { return true; }
 
-                    // If we have never update the previous strings with temp, then we can just copy the exact same string
-                } else if (!alreadyChangedLine) {
-                    outputFile << instrString << "\n";
-                }
-                innerInstrIndex++;
+    PreservedAnalyses run(Function& F, FunctionAnalysisManager& FAM) {
+        if (!openError.empty()) {
+            // Reported on each function, as the pass cannot fail while the pipeline is built
+            F.getContext().emitError(openError);
+            return PreservedAnalyses::all();
+        }
+        dataflow::ResultWriter writer(CSEVerbosity, CSEFormat);
+        writer.function(F.getName());
+        dataflow::PhaseProfile profile(CSEPerfCounters, writer, output->stream());
+
+        bool changed = false;
+        if (CSEMode == CSEEngine::PartialRedundancy) {
+            // The blocks are numbered and split here, so none of the cached analyses are used
+            changed = eliminatePartialRedundancies(F, writer, output->stream());
+            if (CSELoads) {
+                dataflow::CFGIndex cfg(F);
+                dataflow::ReachingDefinitionSets reachingDefs;
+                reachingDefs.compute(F, cfg);
+                DominatorTree DT(F);
+                changed |= eliminateRedundantLoads(F, cfg, reachingDefs, DT, writer, output->stream());
+            }
+            return changed ? PreservedAnalyses::none() : PreservedAnalyses::all();
+        }
+        if (CSEMode == CSEEngine::Scoped) {
+            changed = eliminateDominatedSubexpressions(F, FAM.getResult<dataflow::CFGIndexAnalysis>(F),
+                                                       FAM.getResult<dataflow::InstructionIndexAnalysis>(F),
+                                                       FAM.getResult<DominatorTreeAnalysis>(F), writer, output->stream());
+        } else {
+            changed = eliminateWithDataflow(F, FAM, writer);
+        }
+        // The stores are untouched, so cached reaching definitions still describe F
+        if (CSELoads) {
+            changed |= eliminateRedundantLoads(F, FAM.getResult<dataflow::CFGIndexAnalysis>(F),
+                                               FAM.getResult<dataflow::ReachingDefinitionAnalysis>(F),
+                                               FAM.getResult<DominatorTreeAnalysis>(F), writer, output->stream());
+        }
+        if (!changed) {
+            return PreservedAnalyses::all();
+        }
+        // The block structure is untouched, so the cached CFGIndex and dominator tree stay valid
+        PreservedAnalyses PA;
+        PA.preserveSet<CFGAnalyses>();
+        if (CSEMode == CSEEngine::Dataflow && !CSELoads) {
+            // eliminateToFixpoint brought the instruction index and the sets up to date. The
+            // traced copy of the available expressions was updated instead of the cached one.
+            PA.preserve<dataflow::InstructionIndexAnalysis>();
+            PA.preserve<dataflow::ReachingDefinitionAnalysis>();
+            if (!writer.enabled(dataflow::Verbosity::Trace)) {
+                PA.preserve<dataflow::AvailableExpressionsAnalysis>();
             }
         }
-        return true; // Indicate this is a Transform pass
+        return PA;
     }
-}; // end of struct CSElimination
+
+private:
+    shared_ptr<dataflow::ResultOutput> output; // Shared by the copies the pipeline makes
+    string openError;                          // Why -cse-output could not be opened
+
+    bool eliminateWithDataflow(Function& F, FunctionAnalysisManager& FAM, dataflow::ResultWriter& writer) {
+        // The cached result is built silently; recompute it here when its steps should be traced
+        auto& cfg = FAM.getResult<dataflow::CFGIndexAnalysis>(F);
+        dataflow::AvailableExpressionSets* availableExprs = nullptr;
+        dataflow::AvailableExpressionSets tracedExprs;
+        if (writer.enabled(dataflow::Verbosity::Trace)) {
+            tracedExprs.compute(F, cfg, writer);
+            availableExprs = &tracedExprs;
+        } else {
+            availableExprs = &FAM.getResult<dataflow::AvailableExpressionsAnalysis>(F);
+        }
+        auto& reachingDefs = FAM.getResult<dataflow::ReachingDefinitionAnalysis>(F);
+
+        // The cached results are updated in place, so they still describe F afterwards
+        return eliminateToFixpoint(F, cfg, FAM.getResult<dataflow::InstructionIndexAnalysis>(F), *availableExprs,
+                                   reachingDefs, writer, output->stream());
+    }
+}; // end of struct CSEliminationPass
 } // end of anonymous namespace
 
 char CSElimination::ID = 0;
 static RegisterPass<CSElimination> X("CSElimination", "CSElimination Pass",
                                      false /* Only looks at CFG */,
                                      true /* Tranform Pass */);
+
+void dataflow::registerCSEliminationPasses(PassBuilder& PB) {
+    registerDataflowAnalyses(PB);
+    PB.registerPipelineParsingCallback(
+        [](StringRef name, FunctionPassManager& FPM, ArrayRef<PassBuilder::PipelineElement>) {
+            if (name == "cse-elimination") {
+                FPM.addPass(CSEliminationPass());
+                return true;
+            }
+            return false;
+        });
+}
+
+// opt -load-pass-plugin=libCSElimination.so -passes=cse-elimination
+extern "C" LLVM_ATTRIBUTE_WEAK PassPluginLibraryInfo llvmGetPassPluginInfo() {
+    return {LLVM_PLUGIN_API_VERSION, "CSElimination", LLVM_VERSION_STRING, dataflow::registerCSEliminationPasses};
+}
@@ -0,0 +1,224 @@
+#ifndef CS201_DATAFLOW_AVAILABLEEXPRESSIONS_H
+#define CS201_DATAFLOW_AVAILABLEEXPRESSIONS_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instruction.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/ModuleSlotTracker.h"
+#include "llvm/IR/Value.h"
+#include "llvm/Support/raw_ostream.h"
+#include "CFGIndex.h"
+#include "DataflowFramework.h"
+#include "PhaseTimer.h"
+#include "ResultWriter.h"
+#include "ValueNumbering.h"
+#include <vector>
+
+namespace dataflow {
+
+using namespace llvm;
+using std::vector;
+
+// Expression number as printed in reports: its operands and first computation,
+// e.g. "%a + %b @ index 12"
+struct Expression {
+    const ValueNumbering& numbering;
+    unsigned number;
+
+    void print(raw_ostream& out, ModuleSlotTracker* slots = nullptr) const {
+        numbering.print(out, number, slots);
+        out << " @ index " << numbering.firstIndex[number] << "\n";
+    }
+};
+
+inline raw_ostream& operator<<(raw_ostream& out, const Expression& exp) {
+    exp.print(out);
+    return out;
+}
+
+// Available expressions for every block.
+// The expressions are those of the function's value numbering, numbered in
+// order of first occurrence, so GEN, KILL, IN and OUT are BitVectors over the
+// expression numbers, the meet is a word-wide AND and OUT = GEN + (IN - KILL)
+// is a few word operations per block.
+struct AvailableExpressionSets {
+    ValueNumbering numbering;
+
+    vector<BitVector> genSets;
+    vector<BitVector> killSets;
+    vector<BitVector> inSets;
+    vector<BitVector> outSets;
+    unsigned iterations = 0; // Blocks visited by the worklist solver
+
+    unsigned numExpressions() const { return numbering.size(); }
+
+    // Number of the expression inst computes, or -1 if it computes none
+    int expressionOf(const Instruction& inst) const { return numbering.numberOf(inst); }
+
+    // The expressions a store to location kills
+    ArrayRef<unsigned> expressionsReading(const Value* location) const { return numbering.expressionsReading(location); }
+
+    // Expression number as printed in reports: its operands and first computation
+    Expression expressionAt(unsigned number) const { return Expression{numbering, number}; }
+
+    // The first-computation indices of the members of set, in ascending order
+    void instrIndicesOf(const BitVector& set, SmallVectorImpl<unsigned>& indices) const {
+        indices.clear();
+        for (unsigned number : set.set_bits()) {
+            indices.push_back(numbering.firstIndex[number]); // Numbered in order of first occurrence, so already sorted
+        }
+    }
+
+    // Builds the universe, GEN and KILL (PASS 1-3) and solves for IN and OUT (PASS 4).
+    // The steps are narrated to writer at trace verbosity.
+    void compute(Function& F, const CFGIndex& cfg, ResultWriter& writer) {
+        PhaseTimer phases("available-expressions", "Available expressions", F.getName());
+
+        // PASS 1: Number every distinct expression
+        phases.start("ae-numbering", "Number the expressions");
+        DATAFLOW_TRACE(writer, "PASS 1: Number the expressions of the function\n");
+        numbering.build(F);
+        for (unsigned number = 0; number < numbering.size(); number++) {
+            DATAFLOW_TRACE(writer, "  Expression " << number << ": " << expressionAt(number));
+        }
+        DATAFLOW_TRACE(writer, "\n");
+
+        // PASS 2: Create GEN sets for each block
+        // PASS 3: Create KILL sets for each block
+        // Both come from one walk over each block (computeBlockSets)
+        DATAFLOW_TRACE(writer, "PASS 2 and 3: Create GEN and KILL sets for each block\n");
+        phases.start("ae-gen-kill", "Available expressions GEN and KILL");
+        unsigned numBlocks = cfg.size();
+        genSets.assign(numBlocks, BitVector(numExpressions()));
+        killSets.assign(numBlocks, BitVector(numExpressions()));
+        for (unsigned blockNum = 0; blockNum < numBlocks; blockNum++) {
+            computeBlockSets(cfg, blockNum, writer);
+        }
+        DATAFLOW_TRACE(writer, "\n");
+
+        // PASS 4: Create IN and OUT sets for each block
+        // Forward problem: IN is the intersection of the predecessors' OUTs, OUT = (IN - KILL) + GEN.
+        // Every block but the entry starts from the full universe and shrinks to the greatest fixpoint.
+        DATAFLOW_TRACE(writer, "PASS 4: Create IN and OUT sets for each block\n");
+        phases.start("ae-solve", "Solve available expressions");
+        iterations = makeSolver(cfg).solve(inSets, outSets, BitVector(numExpressions()), BitVector(numExpressions(), true));
+    }
+
+    // Bring the sets up to date after instructions were replaced, inserted or
+    // deleted in changedBlocks (the CFG itself must be unchanged).
+    // changedBlocks must name every block an instruction was added to or
+    // removed from, or whose operands were replaced. The expressions are
+    // numbered again and the previous sets carried over to the new numbering.
+    // GEN and KILL are recomputed only for the changed blocks and for the
+    // blocks storing to a variable that an expression new to the numbering
+    // reads, and only those blocks and the ones downstream are re-solved.
+    void update(Function& F, const CFGIndex& cfg, ArrayRef<unsigned> changedBlocks) {
+        PhaseTimer phases("available-expressions", "Available expressions", F.getName());
+        phases.start("ae-update", "Update available expressions");
+        ValueNumbering oldNumbering = std::move(numbering);
+        numbering.build(F);
+        vector<unsigned> remap = numbering.renumbering(oldNumbering);
+        BitVector isNew(numExpressions(), true);
+        for (unsigned number : remap) {
+            if (number != ~0U) {
+                isNew.reset(number);
+            }
+        }
+        for (unsigned blockNum = 0; blockNum < cfg.size(); blockNum++) {
+            remapSet(genSets[blockNum], remap);
+            remapSet(killSets[blockNum], remap);
+            remapSet(inSets[blockNum], remap);
+            remapSet(outSets[blockNum], remap);
+        }
+
+        // Blocks whose GEN or KILL may differ: the edited ones, plus every block
+        // storing to a variable a new expression reads (its KILL lacks the expression)
+        BitVector staleBlocks(cfg.size());
+        for (unsigned blockNum : changedBlocks) {
+            staleBlocks.set(blockNum);
+        }
+        SmallPtrSet<const Value*, 16> newlyRead;
+        for (unsigned number : isNew.set_bits()) {
+            newlyRead.insert(numbering.locationsRead(number).begin(), numbering.locationsRead(number).end());
+        }
+        for (unsigned blockNum = 0; blockNum < cfg.size() && !newlyRead.empty(); blockNum++) {
+            for (auto& inst : *cfg.blocks[blockNum]) {
+                const auto* store = dyn_cast<StoreInst>(&inst);
+                if (store && newlyRead.count(store->getPointerOperand())) {
+                    staleBlocks.set(blockNum);
+                    break;
+                }
+            }
+        }
+        ResultWriter silent(Verbosity::None, OutputFormat::Text);
+        SmallVector<unsigned, 16> staleList;
+        for (unsigned blockNum : staleBlocks.set_bits()) {
+            computeBlockSets(cfg, blockNum, silent);
+            staleList.push_back(blockNum);
+        }
+
+        iterations = makeSolver(cfg).resolve(inSets, outSets, BitVector(numExpressions()),
+                                             BitVector(numExpressions(), true), staleList);
+    }
+
+private:
+    // GEN and KILL of one block from one walk over it: a computation sets its
+    // GEN bit, and a later store to a variable it reads clears it again and
+    // sets the KILL bit
+    void computeBlockSets(const CFGIndex& cfg, unsigned blockNum, ResultWriter& writer) {
+        DATAFLOW_TRACE(writer, "Block " << blockNum << ":\n");
+        BitVector& currGenSet = genSets[blockNum];
+        BitVector& currKilledSet = killSets[blockNum];
+        currGenSet.reset();
+        currKilledSet.reset();
+        for (auto& inst : *cfg.blocks[blockNum]) {
+            if (const auto* store = dyn_cast<StoreInst>(&inst)) {
+                for (unsigned number : expressionsReading(store->getPointerOperand())) {
+                    DATAFLOW_TRACE(writer, "  Store to \'" << AsOperand(store->getPointerOperand()) << "\' kills " << expressionAt(number));
+                    currGenSet.reset(number);
+                    currKilledSet.set(number);
+                }
+            } else {
+                int number = expressionOf(inst);
+                if (number >= 0) {
+                    DATAFLOW_TRACE(writer, "  Generates " << expressionAt(number));
+                    currGenSet.set(number);
+                }
+            }
+        }
+    }
+
+    struct Transfer {
+        const AvailableExpressionSets* sets;
+        void operator()(unsigned blockNum, const BitVector& currInSet, BitVector& currOutSet) const {
+            // OUT = (IN - KILL) + GEN
+            currOutSet = currInSet;
+            currOutSet.reset(sets->killSets[blockNum]);
+            currOutSet |= sets->genSets[blockNum];
+        }
+    };
+
+    // Forward problem: IN is the intersection of the predecessors' OUTs
+    DataflowSolver<Direction::Forward, BitVector, IntersectionMeet, Transfer> makeSolver(const CFGIndex& cfg) const {
+        return makeDataflowSolver<Direction::Forward, BitVector>(cfg, IntersectionMeet(), Transfer{this});
+    }
+
+    // Move the bits of a set from the old expression numbering to the new one
+    void remapSet(BitVector& set, const vector<unsigned>& remap) const {
+        BitVector remapped(numExpressions());
+        for (unsigned oldNumber : set.set_bits()) {
+            if (remap[oldNumber] != ~0U) {
+                remapped.set(remap[oldNumber]);
+            }
+        }
+        set = std::move(remapped);
+    }
+};
+
+} // end of namespace dataflow
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef CS201_DATAFLOW_BOUNDEDQUEUE_H
+#define CS201_DATAFLOW_BOUNDEDQUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+namespace dataflow {
+
+// Connects the stages of a pipeline: any number of threads push and pop, a
+// push blocks while the queue is full, so a fast stage cannot run arbitrarily
+// far ahead of a slow one, and a pop blocks while it is empty. Once every
+// producer is done, close() lets the consumers drain what is left and stop.
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(capacity ? capacity : 1) {}
+
+    void push(T item) {
+        std::unique_lock<std::mutex> guard(lock);
+        notFull.wait(guard, [this] { return items.size() < capacity; });
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+    }
+
+    // Returns false once the queue is closed and empty
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> guard(lock);
+        notEmpty.wait(guard, [this] { return !items.empty() || closed; });
+        if (items.empty()) {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> guard(lock);
+        closed = true;
+        notEmpty.notify_all();
+    }
+
+private:
+    size_t capacity;
+    std::deque<T> items;
+    bool closed = false;
+    std::mutex lock;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+};
+
+} // end of namespace dataflow
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef CS201_DATAFLOW_CFGINDEX_H
+#define CS201_DATAFLOW_CFGINDEX_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Function.h"
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace dataflow {
+
+using namespace llvm;
+
+// Block numbering and flat (CSR) predecessor/successor arrays for a function.
+// Blocks are numbered in layout order, matching the "Block N" numbers the
+// passes print. Built once per function and shared by the solvers and
+// printers, so no CFG walk ever has to search for a block's number.
+struct CFGIndex {
+    std::vector<BasicBlock*> blocks; // Block number -> block
+    DenseMap<const BasicBlock*, unsigned> numbers;
+
+    // Predecessors of block b are predIndices[predOffsets[b] .. predOffsets[b + 1])
+    std::vector<unsigned> predOffsets;
+    std::vector<unsigned> predIndices;
+    std::vector<unsigned> succOffsets;
+    std::vector<unsigned> succIndices;
+
+    std::vector<unsigned> rpo;       // Reachable block numbers in reverse post-order
+    std::vector<unsigned> rpoNumber; // Block number -> position in rpo, ~0U if unreachable
+
+    CFGIndex() = default;
+    explicit CFGIndex(Function& F) { build(F); }
+
+    void build(Function& F) {
+        blocks.clear();
+        numbers.clear();
+        for (auto& basic_block : F) {
+            numbers[&basic_block] = blocks.size();
+            blocks.push_back(&basic_block);
+        }
+
+        unsigned numBlocks = blocks.size();
+        predOffsets.assign(1, 0);
+        predIndices.clear();
+        succOffsets.assign(1, 0);
+        succIndices.clear();
+        for (BasicBlock* block : blocks) {
+            for (auto* pred : predecessors(block)) {
+                predIndices.push_back(numbers.lookup(pred));
+            }
+            predOffsets.push_back(predIndices.size());
+            for (auto* succ : successors(block)) {
+                succIndices.push_back(numbers.lookup(succ));
+            }
+            succOffsets.push_back(succIndices.size());
+        }
+
+        // Iterative depth-first search from the entry block for the post-order
+        rpo.clear();
+        rpoNumber.assign(numBlocks, ~0U);
+        if (numBlocks == 0) {
+            return;
+        }
+        std::vector<bool> visited(numBlocks, false);
+        std::vector<std::pair<unsigned, unsigned>> stack; // (block, next successor slot)
+        stack.push_back({0, succOffsets[0]});
+        visited[0] = true;
+        while (!stack.empty()) {
+            unsigned block = stack.back().first;
+            unsigned& nextSucc = stack.back().second;
+            if (nextSucc == succOffsets[block + 1]) {
+                rpo.push_back(block);
+                stack.pop_back();
+                continue;
+            }
+            unsigned succ = succIndices[nextSucc++];
+            if (!visited[succ]) {
+                visited[succ] = true;
+                stack.push_back({succ, succOffsets[succ]});
+            }
+        }
+        std::reverse(rpo.begin(), rpo.end());
+        for (unsigned i = 0; i < rpo.size(); i++) {
+            rpoNumber[rpo[i]] = i;
+        }
+    }
+
+    unsigned size() const { return blocks.size(); }
+
+    unsigned number(const BasicBlock* block) const { return numbers.lookup(block); }
+
+    bool isReachable(unsigned block) const { return rpoNumber[block] != ~0U; }
+
+    ArrayRef<unsigned> preds(unsigned block) const {
+        return makeArrayRef(predIndices.data() + predOffsets[block], predOffsets[block + 1] - predOffsets[block]);
+    }
+
+    ArrayRef<unsigned> succs(unsigned block) const {
+        return makeArrayRef(succIndices.data() + succOffsets[block], succOffsets[block + 1] - succOffsets[block]);
+    }
+};
+
+} // end of namespace dataflow
+
+#endif
@@ -0,0 +1,47 @@
+#include "DataflowAnalyses.h"
+
+using namespace llvm;
+
+namespace dataflow {
+
+AnalysisKey CFGIndexAnalysis::Key;
+AnalysisKey InstructionIndexAnalysis::Key;
+AnalysisKey ReachingDefinitionAnalysis::Key;
+AnalysisKey AvailableExpressionsAnalysis::Key;
+
+namespace {
+template <typename AnalysisT>
+bool parseAnalysisUtility(StringRef name, StringRef analysisName, FunctionPassManager& FPM) {
+    if (!name.consume_back(">")) {
+        return false;
+    }
+    if (name.consume_front("require<") && name == analysisName) {
+        FPM.addPass(RequireAnalysisPass<AnalysisT, Function>());
+        return true;
+    }
+    if (name.consume_front("invalidate<") && name == analysisName) {
+        FPM.addPass(InvalidateAnalysisPass<AnalysisT>());
+        return true;
+    }
+    return false;
+}
+} // end of anonymous namespace
+
+void registerDataflowAnalyses(PassBuilder& PB) {
+    PB.registerAnalysisRegistrationCallback([](FunctionAnalysisManager& FAM) {
+        // A second plugin registering the same analysis is ignored
+        FAM.registerPass([] { return CFGIndexAnalysis(); });
+        FAM.registerPass([] { return InstructionIndexAnalysis(); });
+        FAM.registerPass([] { return ReachingDefinitionAnalysis(); });
+        FAM.registerPass([] { return AvailableExpressionsAnalysis(); });
+    });
+    PB.registerPipelineParsingCallback(
+        [](StringRef name, FunctionPassManager& FPM, ArrayRef<PassBuilder::PipelineElement>) {
+            return parseAnalysisUtility<CFGIndexAnalysis>(name, "cfg-index", FPM) ||
+                   parseAnalysisUtility<InstructionIndexAnalysis>(name, "instruction-index", FPM) ||
+                   parseAnalysisUtility<ReachingDefinitionAnalysis>(name, "reaching-definitions", FPM) ||
+                   parseAnalysisUtility<AvailableExpressionsAnalysis>(name, "available-expressions", FPM);
+        });
+}
+
+} // end of namespace dataflow
@@ -0,0 +1,121 @@
+#ifndef CS201_DATAFLOW_DATAFLOWANALYSES_H
+#define CS201_DATAFLOW_DATAFLOWANALYSES_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "AvailableExpressions.h"
+#include "CFGIndex.h"
+#include "InstructionIndex.h"
+#include "ReachingDefinitionSets.h"
+#include "ResultWriter.h"
+
+namespace dataflow {
+
+using namespace llvm;
+
+// New pass manager analyses. Results are cached in the FunctionAnalysisManager
+// and dropped when a pass does not preserve them, so the printers and the CSE
+// transform share one computation per function.
+//
+// The analysis keys are defined in DataflowAnalyses.cpp, which every plugin
+// using these analyses compiles in.
+
+// Block numbering and CSR edges; only invalidated when the CFG changes
+class CFGIndexAnalysis : public AnalysisInfoMixin<CFGIndexAnalysis> {
+    friend AnalysisInfoMixin<CFGIndexAnalysis>;
+    static AnalysisKey Key;
+
+public:
+    struct Result : CFGIndex {
+        explicit Result(Function& F) : CFGIndex(F) {}
+
+        bool invalidate(Function&, const PreservedAnalyses& PA, FunctionAnalysisManager::Invalidator&) {
+            auto checker = PA.getChecker<CFGIndexAnalysis>();
+            return !(checker.preserved() || checker.preservedSet<AllAnalysesOn<Function>>() ||
+                     checker.preservedSet<CFGAnalyses>());
+        }
+    };
+
+    Result run(Function& F, FunctionAnalysisManager&) { return Result(F); }
+};
+
+// Instruction numbering; invalidated by any change a pass does not declare preserved
+class InstructionIndexAnalysis : public AnalysisInfoMixin<InstructionIndexAnalysis> {
+    friend AnalysisInfoMixin<InstructionIndexAnalysis>;
+    static AnalysisKey Key;
+
+public:
+    struct Result : InstructionIndex {
+        explicit Result(Function& F) : InstructionIndex(F) {}
+
+        bool invalidate(Function&, const PreservedAnalyses& PA, FunctionAnalysisManager::Invalidator&) {
+            auto checker = PA.getChecker<InstructionIndexAnalysis>();
+            return !(checker.preserved() || checker.preservedSet<AllAnalysesOn<Function>>());
+        }
+    };
+
+    Result run(Function& F, FunctionAnalysisManager&) { return Result(F); }
+};
+
+// Dense reaching definitions (ReachingDefinitionSets) over the cached CFGIndex
+class ReachingDefinitionAnalysis : public AnalysisInfoMixin<ReachingDefinitionAnalysis> {
+    friend AnalysisInfoMixin<ReachingDefinitionAnalysis>;
+    static AnalysisKey Key;
+
+public:
+    struct Result : ReachingDefinitionSets {
+        const CFGIndex* cfg = nullptr; // Owned by the analysis manager
+
+        bool invalidate(Function& F, const PreservedAnalyses& PA, FunctionAnalysisManager::Invalidator& inv) {
+            auto checker = PA.getChecker<ReachingDefinitionAnalysis>();
+            return !(checker.preserved() || checker.preservedSet<AllAnalysesOn<Function>>()) ||
+                   inv.invalidate<CFGIndexAnalysis>(F, PA);
+        }
+    };
+
+    Result run(Function& F, FunctionAnalysisManager& FAM) {
+        Result result;
+        result.cfg = &FAM.getResult<CFGIndexAnalysis>(F);
+        result.compute(F, *result.cfg);
+        return result;
+    }
+};
+
+// Available expressions (AvailableExpressionSets) over the cached CFGIndex
+class AvailableExpressionsAnalysis : public AnalysisInfoMixin<AvailableExpressionsAnalysis> {
+    friend AnalysisInfoMixin<AvailableExpressionsAnalysis>;
+    static AnalysisKey Key;
+
+public:
+    struct Result : AvailableExpressionSets {
+        bool invalidate(Function& F, const PreservedAnalyses& PA, FunctionAnalysisManager::Invalidator& inv) {
+            auto checker = PA.getChecker<AvailableExpressionsAnalysis>();
+            return !(checker.preserved() || checker.preservedSet<AllAnalysesOn<Function>>()) ||
+                   inv.invalidate<CFGIndexAnalysis>(F, PA);
+        }
+    };
+
+    Result run(Function& F, FunctionAnalysisManager& FAM) {
+        Result result;
+        ResultWriter silent(Verbosity::None, OutputFormat::Text);
+        result.compute(F, FAM.getResult<CFGIndexAnalysis>(F), silent);
+        return result;
+    }
+};
+
+// Registers the analyses with a plugin's PassBuilder, along with
+// require<name> and invalidate<name> for the pipeline text, where name is
+// cfg-index, instruction-index, reaching-definitions or available-expressions
+void registerDataflowAnalyses(PassBuilder& PB);
+
+// Registers a pass plugin's analyses and pipeline names with PB, for
+// dataflow-driver, which links the passes in instead of loading the plugins.
+// Each is defined with its pass and is what the plugin's entry point calls.
+void registerReachingDefinitionPasses(PassBuilder& PB); // print<reaching-definitions>
+void registerCSEliminationPasses(PassBuilder& PB);      // cse-elimination
+
+} // end of namespace dataflow
+
+#endif
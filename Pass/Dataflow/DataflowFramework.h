@@ -0,0 +1,184 @@
+#ifndef CS201_DATAFLOW_DATAFLOWFRAMEWORK_H
+#define CS201_DATAFLOW_DATAFLOWFRAMEWORK_H
+
+#include "llvm/ADT/BitVector.h"
+#include "CFGIndex.h"
+#include <functional>
+#include <queue>
+#include <utility>
+#include <vector>
+
+namespace dataflow {
+
+using namespace llvm;
+
+enum class Direction { Forward, Backward };
+
+// Meet operators for bit-vector domains
+struct UnionMeet {
+    void operator()(BitVector& into, const BitVector& value) const { into |= value; }
+};
+
+struct IntersectionMeet {
+    void operator()(BitVector& into, const BitVector& value) const { into &= value; }
+};
+
+// Iterative worklist solver shared by every analysis.
+//
+// The analysis is fixed at compile time by four template parameters:
+//   Dir       - Forward (IN = meet of predecessors' OUT) or Backward (OUT = meet of successors' IN)
+//   DomainT   - the lattice value stored per block; must be copyable and comparable with ==
+//   MeetT     - functor meet(DomainT& into, const DomainT& value)
+//   TransferT - functor transfer(unsigned block, const DomainT& input, DomainT& output)
+// so the inner loop calls the meet and transfer functions directly, with no virtual dispatch.
+//
+// Blocks are visited in reverse post-order (post-order for backward problems) and a block's
+// neighbours are re-queued only when its result changed. Blocks unreachable from the entry are
+// never visited, keep the boundary value and are ignored by the meet. After an edit to some
+// blocks, resolve() re-runs the iteration on just the part of the CFG the edit can affect.
+template <Direction Dir, typename DomainT, typename MeetT, typename TransferT>
+class DataflowSolver {
+public:
+    DataflowSolver(const CFGIndex& cfg, MeetT meet, TransferT transfer)
+        : cfg(cfg), meet(std::move(meet)), transfer(std::move(transfer)) {}
+
+    // boundary: value flowing into the entry block (forward) or out of the exit blocks (backward)
+    // initial: starting value of every block's result, the top of the lattice
+    // Returns the number of block visits the solver needed.
+    unsigned solve(std::vector<DomainT>& inSets, std::vector<DomainT>& outSets, const DomainT& boundary, const DomainT& initial) {
+        unsigned numBlocks = cfg.size();
+        inSets.assign(numBlocks, boundary);
+        outSets.assign(numBlocks, boundary);
+
+        unsigned numReachable = cfg.rpo.size();
+        BitVector region(numReachable, true);
+        return iterate(inSets, outSets, boundary, initial, region);
+    }
+
+    // Re-solve after the transfer function of some blocks changed (their
+    // instructions were replaced, inserted or deleted; the CFG is the same).
+    // Only the changed blocks and the blocks their results flow into can get a
+    // different answer, so that region is reset to the initial value and
+    // iterated again while every other block keeps its previous result, which
+    // the region's meet reads as a fixed input. inSets and outSets must hold
+    // the previous solution. Returns the number of block visits.
+    unsigned resolve(std::vector<DomainT>& inSets, std::vector<DomainT>& outSets, const DomainT& boundary,
+                     const DomainT& initial, ArrayRef<unsigned> changedBlocks) {
+        unsigned numReachable = cfg.rpo.size();
+        BitVector region(numReachable);
+        std::vector<unsigned> stack;
+        for (unsigned block : changedBlocks) {
+            if (cfg.isReachable(block) && !region.test(orderOf(block))) {
+                region.set(orderOf(block));
+                stack.push_back(block);
+            }
+        }
+        while (!stack.empty()) {
+            unsigned block = stack.back();
+            stack.pop_back();
+            for (unsigned neighbour : flowOutOf(block)) {
+                if (cfg.isReachable(neighbour) && !region.test(orderOf(neighbour))) {
+                    region.set(orderOf(neighbour));
+                    stack.push_back(neighbour);
+                }
+            }
+        }
+        return iterate(inSets, outSets, boundary, initial, region);
+    }
+
+private:
+    const CFGIndex& cfg;
+    MeetT meet;
+    TransferT transfer;
+
+    // Worklist iteration over the blocks in region (a set of visit-order numbers),
+    // starting them from the initial value
+    unsigned iterate(std::vector<DomainT>& inSets, std::vector<DomainT>& outSets, const DomainT& boundary,
+                     const DomainT& initial, const BitVector& region) {
+        // A forward problem reads its inputs from OUT sets, a backward one from IN sets
+        std::vector<DomainT>& inputs = (Dir == Direction::Forward) ? inSets : outSets;
+        std::vector<DomainT>& results = (Dir == Direction::Forward) ? outSets : inSets;
+
+        // Worklist entries are visit-order numbers so the earliest pending block is taken first
+        std::priority_queue<unsigned, std::vector<unsigned>, std::greater<unsigned>> worklist;
+        BitVector onWorklist = region;
+        for (unsigned order : region.set_bits()) {
+            results[blockAt(order)] = initial;
+            worklist.push(order);
+        }
+
+        unsigned iterations = 0;
+        DomainT newResult;
+        while (!worklist.empty()) {
+            unsigned order = worklist.top();
+            worklist.pop();
+            onWorklist.reset(order);
+            unsigned block = blockAt(order);
+            iterations++;
+
+            // Meet over the neighbours the values flow in from
+            DomainT& input = inputs[block];
+            bool first = true;
+            for (unsigned neighbour : flowInto(block)) {
+                if (!cfg.isReachable(neighbour)) {
+                    continue;
+                }
+                if (first) {
+                    input = results[neighbour];
+                    first = false;
+                } else {
+                    meet(input, results[neighbour]);
+                }
+            }
+            if (first) {
+                input = boundary; // Entry block (forward) or exit block (backward)
+            }
+
+            transfer(block, input, newResult);
+            if (newResult == results[block]) {
+                continue;
+            }
+            std::swap(results[block], newResult);
+
+            for (unsigned neighbour : flowOutOf(block)) {
+                if (!cfg.isReachable(neighbour)) {
+                    continue;
+                }
+                unsigned neighbourOrder = orderOf(neighbour);
+                if (!onWorklist.test(neighbourOrder)) {
+                    onWorklist.set(neighbourOrder);
+                    worklist.push(neighbourOrder);
+                }
+            }
+        }
+        return iterations;
+    }
+
+    ArrayRef<unsigned> flowInto(unsigned block) const {
+        return (Dir == Direction::Forward) ? cfg.preds(block) : cfg.succs(block);
+    }
+
+    ArrayRef<unsigned> flowOutOf(unsigned block) const {
+        return (Dir == Direction::Forward) ? cfg.succs(block) : cfg.preds(block);
+    }
+
+    // Forward problems visit blocks in reverse post-order, backward ones in post-order
+    unsigned blockAt(unsigned order) const {
+        return (Dir == Direction::Forward) ? cfg.rpo[order] : cfg.rpo[cfg.rpo.size() - 1 - order];
+    }
+
+    unsigned orderOf(unsigned block) const {
+        return (Dir == Direction::Forward) ? cfg.rpoNumber[block] : cfg.rpo.size() - 1 - cfg.rpoNumber[block];
+    }
+};
+
+// Deduces the domain, meet and transfer types, e.g.
+//   auto solver = makeDataflowSolver<Direction::Forward, BitVector>(cfg, UnionMeet(), transferLambda);
+template <Direction Dir, typename DomainT, typename MeetT, typename TransferT>
+DataflowSolver<Dir, DomainT, MeetT, TransferT> makeDataflowSolver(const CFGIndex& cfg, MeetT meet, TransferT transfer) {
+    return DataflowSolver<Dir, DomainT, MeetT, TransferT>(cfg, std::move(meet), std::move(transfer));
+}
+
+} // end of namespace dataflow
+
+#endif
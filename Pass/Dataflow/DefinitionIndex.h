@@ -0,0 +1,80 @@
+#ifndef CS201_DATAFLOW_DEFINITIONINDEX_H
+#define CS201_DATAFLOW_DEFINITIONINDEX_H
+
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "CFGIndex.h"
+#include <vector>
+
+namespace dataflow {
+
+using namespace llvm;
+
+// Numbering of the definitions (stores) in a function, shared by the dense and
+// sparse reaching-definitions engines. Every store gets an index in program
+// order, and every store destination is a variable with the list of
+// definitions that write it.
+struct DefinitionIndex {
+    std::vector<StoreInst*> definitions;        // Definition index -> store instruction
+    std::vector<unsigned> definitionInstrIndex; // Definition index -> instruction index in the function
+    std::vector<unsigned> definitionBlock;      // Definition index -> block number
+    std::vector<unsigned> definitionVariable;   // Definition index -> variable number
+
+    DenseMap<const Value*, unsigned> variableNumbers;
+    std::vector<Value*> variables;                   // Variable number -> store destination
+    std::vector<std::vector<unsigned>> variableDefs; // Variable number -> its definitions in program order
+
+    void buildIndex(Function& F, const CFGIndex& cfg) {
+        definitions.clear();
+        definitionInstrIndex.clear();
+        definitionBlock.clear();
+        definitionVariable.clear();
+        variableNumbers.clear();
+        variables.clear();
+        variableDefs.clear();
+
+        unsigned instrIndex = 0;
+        for (unsigned blockNum = 0; blockNum < cfg.size(); blockNum++) {
+            for (auto& inst : *cfg.blocks[blockNum]) {
+                if (auto* store = dyn_cast<StoreInst>(&inst)) {
+                    Value* storeDestination = store->getPointerOperand();
+                    auto inserted = variableNumbers.insert({storeDestination, variables.size()});
+                    if (inserted.second) {
+                        variables.push_back(storeDestination);
+                        variableDefs.emplace_back();
+                    }
+                    unsigned variable = inserted.first->second;
+                    variableDefs[variable].push_back(definitions.size());
+                    definitionVariable.push_back(variable);
+                    definitionBlock.push_back(blockNum);
+                    definitions.push_back(store);
+                    definitionInstrIndex.push_back(instrIndex);
+                }
+                instrIndex++;
+            }
+        }
+    }
+
+    unsigned numDefinitions() const { return definitions.size(); }
+
+    // Variable number for a pointer, or ~0U if nothing ever stores to it
+    unsigned variableOf(const Value* pointer) const {
+        auto found = variableNumbers.find(pointer);
+        return found == variableNumbers.end() ? ~0U : found->second;
+    }
+
+    // The instruction indices of the definitions in a set, in ascending order
+    void instrIndicesOf(const BitVector& defs, SmallVectorImpl<unsigned>& instrIndices) const {
+        instrIndices.clear();
+        for (unsigned defIndex : defs.set_bits()) {
+            instrIndices.push_back(definitionInstrIndex[defIndex]);
+        }
+    }
+};
+
+} // end of namespace dataflow
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef CS201_DATAFLOW_INSTRUCTIONINDEX_H
+#define CS201_DATAFLOW_INSTRUCTIONINDEX_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instruction.h"
+#include <vector>
+
+namespace dataflow {
+
+using namespace llvm;
+
+// Instruction numbering of a function: the "Index N" every pass prints,
+// counting from 0 in layout order. Built once per function, so an index is
+// mapped to its instruction (and back) without walking the function again.
+// Any instruction added or removed afterwards makes it stale.
+struct InstructionIndex {
+    std::vector<Instruction*> instructions;         // Index -> instruction
+    DenseMap<const Instruction*, unsigned> indices; // Instruction -> index
+    std::vector<unsigned> blockStart;               // Block number -> index of its first instruction, plus the total
+
+    InstructionIndex() = default;
+    explicit InstructionIndex(Function& F) { build(F); }
+
+    void build(Function& F) {
+        instructions.clear();
+        indices.clear();
+        blockStart.clear();
+        for (auto& basic_block : F) {
+            blockStart.push_back(instructions.size());
+            for (auto& inst : basic_block) {
+                indices[&inst] = instructions.size();
+                instructions.push_back(&inst);
+            }
+        }
+        blockStart.push_back(instructions.size());
+    }
+
+    unsigned size() const { return instructions.size(); }
+
+    unsigned numBlocks() const { return blockStart.size() - 1; }
+
+    Instruction* at(unsigned index) const { return instructions[index]; }
+
+    unsigned indexOf(const Instruction* inst) const { return indices.lookup(inst); }
+
+    // The instructions of block blockNum in order; the first is at blockStart[blockNum]
+    ArrayRef<Instruction*> block(unsigned blockNum) const {
+        return ArrayRef<Instruction*>(instructions).slice(blockStart[blockNum], blockStart[blockNum + 1] - blockStart[blockNum]);
+    }
+};
+
+} // end of namespace dataflow
+
+#endif
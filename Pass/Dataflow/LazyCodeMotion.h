@@ -0,0 +1,206 @@
+#ifndef CS201_DATAFLOW_LAZYCODEMOTION_H
+#define CS201_DATAFLOW_LAZYCODEMOTION_H
+
+#include "llvm/ADT/BitVector.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/Argument.h"
+#include "llvm/IR/Constant.h"
+#include "llvm/IR/Instructions.h"
+#include "CFGIndex.h"
+#include "DataflowFramework.h"
+#include "PhaseTimer.h"
+#include "ResultWriter.h"
+#include "ValueNumbering.h"
+#include <vector>
+
+namespace dataflow {
+
+using namespace llvm;
+using std::vector;
+
+// Lazy code motion (Knoop, Ruething and Steffen) over the expressions of a
+// value numbering, in the block formulation of the Dragon book (9.5). The CFG
+// must have no critical edges, so every edge has a block to insert on.
+//
+// Four problems are solved: anticipated (backward), available (forward, with
+// anticipated expressions counted as placed), postponable (forward) and used
+// (backward). An expression belongs at the start of its latest blocks where
+// its value is used later (latest and usedOut). A latest block that computes
+// it upward-exposed keeps that computation as the placement. Any other is
+// given one before its terminator: latest implies anticipated on entry, and
+// with no upward-exposed use the block neither computes nor kills it, so the
+// value at the end is the one at the start. Every upward-exposed computation
+// a placement reaches is then replaced, so the expression is computed at most
+// once on every path and never on a path that did not compute it before.
+struct LazyCodeMotionSets {
+    // Expressions that can be computed anywhere: every leaf is a constant, an
+    // argument, a static alloca or a tracked variable
+    BitVector candidates;
+    // Expressions that may trap, such as a division by a variable. A call that
+    // might not return kills them, so they are never hoisted above one
+    BitVector trapping;
+
+    // Local properties, over the candidates only
+    vector<BitVector> useSets;  // Computed before any kill in the block (upward exposed)
+    vector<BitVector> killSets; // Reads a variable the block stores to, or may trap and the block may not return
+    vector<BitVector> compSets; // Computed and not killed afterwards (downward exposed)
+
+    vector<BitVector> anticipatedIn;
+    vector<BitVector> anticipatedOut;
+    vector<BitVector> availableIn;
+    vector<BitVector> availableOut;
+    vector<BitVector> earliest;
+    vector<BitVector> postponableIn;
+    vector<BitVector> postponableOut;
+    vector<BitVector> latest;
+    vector<BitVector> usedIn;
+    vector<BitVector> usedOut;
+    unsigned iterations = 0; // Block visits over all four solvers
+
+    void compute(const CFGIndex& cfg, const ValueNumbering& numbering, ResultWriter& writer) {
+        unsigned numExpressions = numbering.size();
+        unsigned numBlocks = cfg.size();
+        BitVector none(numExpressions);
+        BitVector all(numExpressions, true);
+        PhaseTimer phases("lazy-code-motion", "Lazy code motion", cfg.blocks[0]->getParent()->getName());
+        phases.start("lcm-local", "Lazy code motion local properties");
+
+        // Expressions are numbered after their operands, so nested candidates are known first
+        candidates = BitVector(numExpressions);
+        trapping = BitVector(numExpressions);
+        for (unsigned number = 0; number < numExpressions; number++) {
+            const ExpressionKey& key = numbering.keys[number];
+            bool movable = true;
+            for (unsigned i = 0; i < key.numOperands && movable; i++) {
+                OperandId operand = key.operands[i];
+                if (isExpressionOperand(operand)) {
+                    movable = candidates.test(operandExpression(operand));
+                    continue;
+                }
+                const Value* leaf = operandLeaf(operand);
+                const auto* alloca = dyn_cast<AllocaInst>(leaf);
+                movable = isa<Constant>(leaf) || isa<Argument>(leaf) || numbering.isTracked(leaf) ||
+                          (alloca && alloca->isStaticAlloca());
+            }
+            if (movable) {
+                candidates.set(number);
+            }
+            if (!isSafeToSpeculativelyExecute(numbering.representatives[number])) {
+                trapping.set(number);
+            }
+        }
+
+        // Local properties from one walk over each block
+        DATAFLOW_TRACE(writer, "PASS 1: Find the computations and kills of each block\n");
+        useSets.assign(numBlocks, none);
+        killSets.assign(numBlocks, none);
+        compSets.assign(numBlocks, none);
+        for (unsigned blockNum = 0; blockNum < numBlocks; blockNum++) {
+            BitVector& use = useSets[blockNum];
+            BitVector& kill = killSets[blockNum];
+            BitVector& comp = compSets[blockNum];
+            for (auto& inst : *cfg.blocks[blockNum]) {
+                if (const auto* store = dyn_cast<StoreInst>(&inst)) {
+                    for (unsigned number : numbering.expressionsReading(store->getPointerOperand())) {
+                        kill.set(number);
+                        comp.reset(number);
+                    }
+                    continue;
+                }
+                if (!inst.willReturn()) {
+                    kill |= trapping;
+                }
+                int number = numbering.numberOf(inst);
+                if (number >= 0 && candidates.test(number)) {
+                    if (!kill.test(number)) {
+                        use.set(number);
+                    }
+                    comp.set(number);
+                }
+            }
+            use &= candidates;
+            kill &= candidates;
+            DATAFLOW_TRACE(writer, "  Block " << blockNum << ": " << use.count() << " upward exposed, " << kill.count()
+                                              << " killed, " << comp.count() << " downward exposed\n");
+        }
+
+        // PASS 2: Anticipated expressions, IN = USE + (OUT - KILL)
+        DATAFLOW_TRACE(writer, "PASS 2: Anticipated expressions\n");
+        phases.start("lcm-anticipated", "Anticipated expressions");
+        auto transferAnticipated = [this](unsigned blockNum, const BitVector& out, BitVector& in) {
+            in = out;
+            in.reset(killSets[blockNum]);
+            in |= useSets[blockNum];
+        };
+        iterations = makeDataflowSolver<Direction::Backward, BitVector>(cfg, IntersectionMeet(), transferAnticipated)
+                         .solve(anticipatedIn, anticipatedOut, none, all);
+
+        // PASS 3: Available expressions, counting the anticipated ones as placed:
+        // OUT = ((ANTICIPATED_IN + IN) - KILL) + COMP
+        DATAFLOW_TRACE(writer, "PASS 3: Available expressions\n");
+        phases.start("lcm-available", "Available expressions");
+        auto transferAvailable = [this](unsigned blockNum, const BitVector& in, BitVector& out) {
+            out = anticipatedIn[blockNum];
+            out |= in;
+            out.reset(killSets[blockNum]);
+            out |= compSets[blockNum];
+        };
+        iterations += makeDataflowSolver<Direction::Forward, BitVector>(cfg, IntersectionMeet(), transferAvailable)
+                          .solve(availableIn, availableOut, none, all);
+
+        // The earliest blocks an expression can be placed in: anticipated but not yet available
+        earliest.assign(numBlocks, none);
+        for (unsigned blockNum = 0; blockNum < numBlocks; blockNum++) {
+            earliest[blockNum] = anticipatedIn[blockNum];
+            earliest[blockNum].reset(availableIn[blockNum]);
+        }
+
+        // PASS 4: Postponable expressions, OUT = (EARLIEST + IN) - USE
+        DATAFLOW_TRACE(writer, "PASS 4: Postponable expressions\n");
+        phases.start("lcm-postponable", "Postponable expressions");
+        auto transferPostponable = [this](unsigned blockNum, const BitVector& in, BitVector& out) {
+            out = earliest[blockNum];
+            out |= in;
+            out.reset(useSets[blockNum]);
+        };
+        iterations += makeDataflowSolver<Direction::Forward, BitVector>(cfg, IntersectionMeet(), transferPostponable)
+                          .solve(postponableIn, postponableOut, none, all);
+
+        // The latest blocks: placeable here, and used here or not placeable in every successor
+        latest.assign(numBlocks, none);
+        BitVector placeable(numExpressions);
+        BitVector everySuccessor(numExpressions);
+        for (unsigned blockNum = 0; blockNum < numBlocks; blockNum++) {
+            everySuccessor.set();
+            for (unsigned succ : cfg.succs(blockNum)) {
+                placeable = earliest[succ];
+                placeable |= postponableIn[succ];
+                everySuccessor &= placeable;
+            }
+            everySuccessor.flip();
+            everySuccessor |= useSets[blockNum];
+            latest[blockNum] = earliest[blockNum];
+            latest[blockNum] |= postponableIn[blockNum];
+            latest[blockNum] &= everySuccessor;
+        }
+
+        // PASS 5: Used expressions, the placements some later computation reads:
+        // IN = (USE + (OUT - COMP)) - LATEST. A downward-exposed computation
+        // saves its own value, so uses past it do not need an earlier placement.
+        DATAFLOW_TRACE(writer, "PASS 5: Used expressions\n");
+        phases.start("lcm-used", "Used expressions");
+        auto transferUsed = [this](unsigned blockNum, const BitVector& out, BitVector& in) {
+            in = out;
+            in.reset(compSets[blockNum]);
+            in |= useSets[blockNum];
+            in.reset(latest[blockNum]);
+        };
+        iterations += makeDataflowSolver<Direction::Backward, BitVector>(cfg, UnionMeet(), transferUsed)
+                          .solve(usedIn, usedOut, none, none);
+        DATAFLOW_TRACE(writer, "\n");
+    }
+};
+
+} // end of namespace dataflow
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef CS201_DATAFLOW_PERFCOUNTERS_H
+#define CS201_DATAFLOW_PERFCOUNTERS_H
+
+#include <cstdint>
+
+#ifdef __linux__
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace dataflow {
+
+// Event counts of the calling thread from perf_event_open: cycles,
+// instructions, cache misses, branch misses and page faults, in user space.
+// Each event is opened on its own, so where some are missing (no PMU in a
+// VM, perf_event_paranoid too strict, not Linux) the others still count and
+// the missing ones read as 0 and report as unavailable. Counts are scaled up
+// when the kernel multiplexes more events than the PMU has counters.
+class PerfCounters {
+public:
+    enum Event { Cycles, Instructions, CacheMisses, BranchMisses, PageFaults, NumEvents };
+
+    using Counts = uint64_t[NumEvents];
+
+    static const char* eventName(unsigned event) {
+        static const char* const names[NumEvents] = {"cycles", "instructions", "cache-misses", "branch-misses",
+                                                     "page-faults"};
+        return names[event];
+    }
+
+    PerfCounters() {
+        for (int& fd : fds) {
+            fd = -1;
+        }
+#ifdef __linux__
+        const struct {
+            uint32_t type;
+            uint64_t config;
+        } events[NumEvents] = {{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+                               {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+                               {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+                               {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+                               {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS}};
+        for (unsigned event = 0; event < NumEvents; event++) {
+            struct perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = events[event].type;
+            attr.config = events[event].config;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            fds[event] = int(syscall(SYS_perf_event_open, &attr, 0 /* this thread */, -1 /* any CPU */, -1, 0));
+        }
+#endif
+    }
+
+    ~PerfCounters() {
+#ifdef __linux__
+        for (int fd : fds) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+#endif
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool available(unsigned event) const { return fds[event] >= 0; }
+
+    bool anyAvailable() const {
+        for (unsigned event = 0; event < NumEvents; event++) {
+            if (available(event)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Totals since the counters were opened
+    void read(Counts& counts) const {
+        for (unsigned event = 0; event < NumEvents; event++) {
+            counts[event] = 0;
+#ifdef __linux__
+            uint64_t values[3]; // Count, time enabled, time running
+            if (fds[event] < 0 || ::read(fds[event], values, sizeof(values)) != sizeof(values) || values[2] == 0) {
+                continue;
+            }
+            counts[event] = values[2] < values[1] ? uint64_t(double(values[0]) * values[1] / values[2]) : values[0];
+#endif
+        }
+    }
+
+    // Opened the first time a thread asks, closed when it exits
+    static PerfCounters& forThisThread() {
+        static thread_local PerfCounters counters;
+        return counters;
+    }
+
+private:
+    int fds[NumEvents];
+};
+
+} // end of namespace dataflow
+
+#endif
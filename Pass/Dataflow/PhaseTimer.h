@@ -0,0 +1,179 @@
+#ifndef CS201_DATAFLOW_PHASETIMER_H
+#define CS201_DATAFLOW_PHASETIMER_H
+
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/TimeProfiler.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "PerfCounters.h"
+#include "ResultWriter.h"
+#include <string>
+
+namespace dataflow {
+
+using namespace llvm;
+
+// Hardware counter totals per phase for one function, added up by every
+// PhaseTimer on this thread while the profile lives (-cse-perf-counters,
+// -rd-perf-counters). When it ends, it writes a counter per phase and event,
+// with the analysis named "perf:<phase>", to writer and, if given an output,
+// flushes writer to it. Where no event can be counted it does nothing.
+class PhaseProfile {
+public:
+    PhaseProfile(bool enabled, ResultWriter& writer, raw_ostream& output) : PhaseProfile(enabled, writer) {
+        this->output = &output;
+    }
+
+    PhaseProfile(bool enabled, ResultWriter& writer) : writer(writer) {
+        if (enabled && PerfCounters::forThisThread().anyAvailable()) {
+            previous = current();
+            current() = this;
+            installed = true;
+        }
+    }
+
+    ~PhaseProfile() {
+        if (!installed) {
+            return;
+        }
+        current() = previous;
+        const PerfCounters& counters = PerfCounters::forThisThread();
+        raw_ostream* text = writer.textAt(Verbosity::Summary);
+        if (text && !phases.empty()) {
+            *text << "Hardware counters per phase:\n";
+        }
+        for (const Phase& phase : phases) {
+            if (text) {
+                *text << "  " << phase.name << ":";
+            }
+            for (unsigned event = 0; event < PerfCounters::NumEvents; event++) {
+                if (!counters.available(event)) {
+                    continue;
+                }
+                writer.counter("perf:" + phase.name, PerfCounters::eventName(event), phase.counts[event]);
+                if (text) {
+                    *text << " " << phase.counts[event] << " " << PerfCounters::eventName(event);
+                }
+            }
+            if (text) {
+                *text << "\n";
+            }
+        }
+        if (output) {
+            writer.flushTo(*output);
+        }
+    }
+
+    void add(StringRef name, const PerfCounters::Counts& before, const PerfCounters::Counts& after) {
+        Phase* phase = nullptr;
+        for (Phase& existing : phases) {
+            if (existing.name == name) {
+                phase = &existing;
+            }
+        }
+        if (!phase) {
+            phases.push_back({name.str(), {}});
+            phase = &phases.back();
+        }
+        for (unsigned event = 0; event < PerfCounters::NumEvents; event++) {
+            phase->counts[event] += after[event] - before[event];
+        }
+    }
+
+    static PhaseProfile*& current() {
+        static thread_local PhaseProfile* profile = nullptr;
+        return profile;
+    }
+
+private:
+    struct Phase {
+        std::string name;
+        PerfCounters::Counts counts;
+    };
+
+    ResultWriter& writer;
+    raw_ostream* output = nullptr;
+    SmallVector<Phase, 8> phases; // In the order they first ran
+    PhaseProfile* previous = nullptr;
+    bool installed = false;
+};
+
+// Times the phases of one analysis or pass over one function, one after the
+// other: start() ends the running phase and begins the next, and the last one
+// ends with the timer. With -time-passes every phase gets a timer in the
+// group's report, summed over all functions and printed at exit. With
+// -time-trace (clang: -ftime-trace) every phase is an event in the trace, with
+// the function name as its detail. Under a PhaseProfile every phase's
+// hardware counts are added to it. None of these cost more than a check when off.
+//
+// The -time-passes timers are shared by name and not thread-safe, so code
+// analyzing functions concurrently turns them off with ConcurrentPhases.
+// Time-trace events are recorded per thread and need nothing.
+class PhaseTimer {
+public:
+    PhaseTimer(StringRef group, StringRef groupDescription, StringRef function)
+        : group(group), groupDescription(groupDescription), function(function) {}
+
+    ~PhaseTimer() { stop(); }
+
+    void start(StringRef name, StringRef description) {
+        stop();
+        if (TimePassesIsEnabled && !timersOffOnThisThread()) {
+            timer.emplace(name, description, group, groupDescription);
+        }
+        if (getTimeTraceProfilerInstance()) {
+            timeTraceProfilerBegin(description, function);
+            tracing = true;
+        }
+        if ((profile = PhaseProfile::current())) {
+            phase = name;
+            PerfCounters::forThisThread().read(before);
+        }
+    }
+
+    void stop() {
+        if (profile) {
+            PerfCounters::Counts after;
+            PerfCounters::forThisThread().read(after);
+            profile->add(phase, before, after);
+            profile = nullptr;
+        }
+        timer.reset();
+        if (tracing) {
+            timeTraceProfilerEnd();
+            tracing = false;
+        }
+    }
+
+    static bool& timersOffOnThisThread() {
+        static thread_local bool off = false;
+        return off;
+    }
+
+private:
+    StringRef group;
+    StringRef groupDescription;
+    StringRef function;
+    Optional<NamedRegionTimer> timer;
+    bool tracing = false;
+    PhaseProfile* profile = nullptr;
+    StringRef phase;
+    PerfCounters::Counts before;
+};
+
+// Keeps the phases run on this thread out of the -time-passes timers while it lives
+class ConcurrentPhases {
+public:
+    ConcurrentPhases() : previous(PhaseTimer::timersOffOnThisThread()) { PhaseTimer::timersOffOnThisThread() = true; }
+    ~ConcurrentPhases() { PhaseTimer::timersOffOnThisThread() = previous; }
+
+private:
+    bool previous;
+};
+
+} // end of namespace dataflow
+
+#endif
@@ -0,0 +1,205 @@
+#ifndef CS201_DATAFLOW_REACHINGDEFINITIONSETS_H
+#define CS201_DATAFLOW_REACHINGDEFINITIONSETS_H
+
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/raw_ostream.h"
+#include "CFGIndex.h"
+#include "DataflowFramework.h"
+#include "DefinitionIndex.h"
+#include "PhaseTimer.h"
+#include <algorithm>
+#include <vector>
+
+namespace dataflow {
+
+using namespace llvm;
+
+// Dense bit-vector engine for reaching definitions.
+// Every store in the function gets a bit index (its definition index), so the
+// GEN, KILL, IN and OUT sets of a block are BitVectors over the stores and
+// OUT = GEN + (IN - KILL) is a few word-wide operations per block.
+struct ReachingDefinitionSets : DefinitionIndex {
+    std::vector<BitVector> genSets;
+    std::vector<BitVector> killSets;
+    std::vector<BitVector> inSets;
+    std::vector<BitVector> outSets;
+    unsigned iterations = 0; // Blocks visited by the worklist solver
+
+    // Variable number -> all of its definitions as a bitmask
+    std::vector<BitVector> variableMasks;
+
+    void compute(Function& F, const CFGIndex& cfg) {
+        PhaseTimer phases("reaching-definitions", "Reaching definitions", F.getName());
+
+        // First Pass: Give every store a bit, grouped by the variable it writes
+        phases.start("rd-index", "Number the definitions");
+        buildIndex(F, cfg);
+        buildVariableMasks();
+
+        // Second Pass: GEN and KILL for every block
+        phases.start("rd-gen-kill", "Reaching definitions GEN and KILL");
+        unsigned numBlocks = cfg.size();
+        genSets.assign(numBlocks, BitVector(definitions.size()));
+        killSets.assign(numBlocks, BitVector(definitions.size()));
+        for (unsigned blockNum = 0; blockNum < numBlocks; blockNum++) {
+            computeBlockSets(blockNum);
+        }
+
+        phases.start("rd-solve", "Solve reaching definitions");
+        solve(cfg);
+    }
+
+    // Bring the sets up to date after instructions were replaced, inserted or
+    // deleted in changedBlocks (the CFG itself must be unchanged).
+    // The definitions are renumbered, since stores may have come or gone and
+    // the instruction indices have shifted, and the previous sets are carried
+    // over to the new numbering. GEN and KILL are recomputed only for the
+    // changed blocks and for the blocks writing a variable that gained or lost
+    // a definition, and only the stale blocks and those downstream of them
+    // are re-solved. changedBlocks must name every block an instruction was
+    // added to or removed from; deleted stores are only compared by address.
+    void update(Function& F, const CFGIndex& cfg, ArrayRef<unsigned> changedBlocks) {
+        PhaseTimer phases("reaching-definitions", "Reaching definitions", F.getName());
+        phases.start("rd-update", "Update reaching definitions");
+        std::vector<StoreInst*> oldDefinitions = std::move(definitions);
+        std::vector<const Value*> oldDefVariables;
+        for (unsigned variable : definitionVariable) {
+            oldDefVariables.push_back(variables[variable]);
+        }
+        buildIndex(F, cfg);
+        buildVariableMasks();
+
+        // Old definition index -> new one, ~0U for deleted stores
+        DenseMap<const StoreInst*, unsigned> newIndexOf;
+        for (unsigned defIndex = 0; defIndex < definitions.size(); defIndex++) {
+            newIndexOf[definitions[defIndex]] = defIndex;
+        }
+        std::vector<unsigned> remap(oldDefinitions.size(), ~0U);
+        BitVector survived(definitions.size());
+        bool renumbered = oldDefinitions.size() != definitions.size();
+        for (unsigned oldIndex = 0; oldIndex < oldDefinitions.size(); oldIndex++) {
+            // A new store allocated at a deleted one's address is told apart by its variable
+            auto found = newIndexOf.find(oldDefinitions[oldIndex]);
+            if (found != newIndexOf.end() && variables[definitionVariable[found->second]] == oldDefVariables[oldIndex]) {
+                remap[oldIndex] = found->second;
+                survived.set(found->second);
+            }
+            renumbered |= remap[oldIndex] != oldIndex;
+        }
+        if (renumbered) {
+            for (unsigned blockNum = 0; blockNum < cfg.size(); blockNum++) {
+                remapSet(genSets[blockNum], remap);
+                remapSet(killSets[blockNum], remap);
+                remapSet(inSets[blockNum], remap);
+                remapSet(outSets[blockNum], remap);
+            }
+        }
+
+        // Blocks whose GEN or KILL may differ: the edited ones, plus every block
+        // writing a variable whose definitions changed (its KILL covers them all)
+        BitVector staleBlocks(cfg.size());
+        for (unsigned blockNum : changedBlocks) {
+            staleBlocks.set(blockNum);
+        }
+        BitVector changedVariables(variables.size());
+        for (unsigned defIndex = 0; defIndex < definitions.size(); defIndex++) {
+            if (!survived.test(defIndex)) {
+                changedVariables.set(definitionVariable[defIndex]);
+            }
+        }
+        for (unsigned oldIndex = 0; oldIndex < oldDefinitions.size(); oldIndex++) {
+            if (remap[oldIndex] == ~0U) {
+                // A deleted store: its variable is gone if no other store writes it
+                unsigned variable = variableOf(oldDefVariables[oldIndex]);
+                if (variable != ~0U) {
+                    changedVariables.set(variable);
+                }
+            }
+        }
+        for (unsigned variable : changedVariables.set_bits()) {
+            for (unsigned defIndex : variableDefs[variable]) {
+                staleBlocks.set(definitionBlock[defIndex]);
+            }
+        }
+        SmallVector<unsigned, 16> staleList;
+        for (unsigned blockNum : staleBlocks.set_bits()) {
+            computeBlockSets(blockNum);
+            staleList.push_back(blockNum);
+        }
+
+        auto solver = makeSolver(cfg);
+        BitVector empty(definitions.size());
+        iterations = solver.resolve(inSets, outSets, empty, empty, staleList);
+    }
+
+    // Forward, union-meet problem solved by the shared worklist solver.
+    // Unreachable blocks are never visited and keep empty IN and OUT sets.
+    void solve(const CFGIndex& cfg) {
+        auto solver = makeSolver(cfg);
+        BitVector empty(definitions.size());
+        iterations = solver.solve(inSets, outSets, empty, empty);
+    }
+
+private:
+    struct Transfer {
+        const ReachingDefinitionSets* sets;
+        void operator()(unsigned blockNum, const BitVector& IN, BitVector& OUT) const {
+            // OUT = (IN - KILL) + GEN
+            OUT = IN;
+            OUT.reset(sets->killSets[blockNum]);
+            OUT |= sets->genSets[blockNum];
+        }
+    };
+
+    DataflowSolver<Direction::Forward, BitVector, UnionMeet, Transfer> makeSolver(const CFGIndex& cfg) const {
+        return makeDataflowSolver<Direction::Forward, BitVector>(cfg, UnionMeet(), Transfer{this});
+    }
+
+    void buildVariableMasks() {
+        variableMasks.assign(variables.size(), BitVector(definitions.size()));
+        for (unsigned variable = 0; variable < variables.size(); variable++) {
+            for (unsigned defIndex : variableDefs[variable]) {
+                variableMasks[variable].set(defIndex);
+            }
+        }
+    }
+
+    // GEN is the last store to each variable in the block;
+    // KILL is every definition of the variables the block writes, minus GEN
+    void computeBlockSets(unsigned blockNum) {
+        BitVector& GEN = genSets[blockNum];
+        BitVector& KILL = killSets[blockNum];
+        GEN.reset();
+        KILL.reset();
+        SmallDenseMap<unsigned, unsigned, 16> lastDefOfVariable;
+        auto blockDefs = std::equal_range(definitionBlock.begin(), definitionBlock.end(), blockNum);
+        for (auto it = blockDefs.first; it != blockDefs.second; ++it) {
+            unsigned defIndex = it - definitionBlock.begin();
+            lastDefOfVariable[definitionVariable[defIndex]] = defIndex;
+        }
+        for (auto& varAndDef : lastDefOfVariable) {
+            GEN.set(varAndDef.second);
+            KILL |= variableMasks[varAndDef.first];
+        }
+        KILL.reset(GEN);
+    }
+
+    // Move the bits of a set from the old definition numbering to the new one
+    void remapSet(BitVector& set, const std::vector<unsigned>& remap) const {
+        BitVector remapped(definitions.size());
+        for (unsigned oldIndex : set.set_bits()) {
+            if (remap[oldIndex] != ~0U) {
+                remapped.set(remap[oldIndex]);
+            }
+        }
+        set = std::move(remapped);
+    }
+};
+
+} // end of namespace dataflow
+
+#endif
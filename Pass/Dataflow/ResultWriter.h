@@ -0,0 +1,371 @@
+#ifndef CS201_DATAFLOW_RESULTWRITER_H
+#define CS201_DATAFLOW_RESULTWRITER_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/EndianStream.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace dataflow {
+
+using namespace llvm;
+
+// How much a pass reports. Each level includes the ones before it.
+//   None    - nothing
+//   Summary - one header per function plus counters (solver visits, transforms found)
+//   Sets    - the per-block IN/OUT/GEN/KILL sets and the listings needed to read them
+//   Trace   - step-by-step narration of how the sets were built; compiled out under NDEBUG
+enum class Verbosity { None, Summary, Sets, Trace };
+
+// Text is the human-readable layout the passes have always printed. JSON
+// writes one object per line; Binary is a compact little-endian record
+// stream (see the README for the layout). Free-form text and trace lines are
+// only written in the Text format.
+enum class OutputFormat { Text, JSON, Binary };
+
+// A named set of a block, as the instruction indices of its members in ascending order
+struct NamedSet {
+    StringRef name;
+    ArrayRef<unsigned> members;
+};
+
+// Collects one function's results in memory so nothing is written one line
+// at a time to an unbuffered stream; the caller flushes it when the function
+// is done. Everything below the selected verbosity is skipped before it is
+// formatted.
+class ResultWriter {
+public:
+    // Binary record tags
+    enum RecordKind : uint8_t { FunctionRecord = 1, BlockSetsRecord = 2, PointSetRecord = 3, CounterRecord = 4 };
+
+    ResultWriter(Verbosity verbosity, OutputFormat format) : verbosity(verbosity), format(format), stream(buffer) {}
+
+    bool enabled(Verbosity level) const {
+#ifdef NDEBUG
+        if (level == Verbosity::Trace) {
+            return false;
+        }
+#endif
+        return level <= verbosity;
+    }
+
+    // The stream for free-form text at a level, or null when that text is not wanted
+    raw_ostream* textAt(Verbosity level) {
+        return (format == OutputFormat::Text && enabled(level)) ? &stream : nullptr;
+    }
+
+    // Start a function's results: prints the "Function:" header (Summary level)
+    void function(StringRef name) {
+        setFunction(name);
+        if (!enabled(Verbosity::Summary)) {
+            return;
+        }
+        switch (format) {
+        case OutputFormat::Text:
+            stream << "\nFunction: " << name << "\n";
+            break;
+        case OutputFormat::JSON:
+            stream << "{\"function\":";
+            writeJSONString(name);
+            stream << "}\n";
+            break;
+        case OutputFormat::Binary:
+            writeByte(FunctionRecord);
+            writeString(name);
+            break;
+        }
+    }
+
+    // Name the function later records belong to, without writing a header
+    void setFunction(StringRef name) { functionName = name; }
+
+    // The sets of one block (Sets level)
+    void blockSets(StringRef analysis, unsigned block, ArrayRef<NamedSet> sets) {
+        if (!enabled(Verbosity::Sets)) {
+            return;
+        }
+        switch (format) {
+        case OutputFormat::Text:
+            stream << "\nBlock " << block << ":";
+            for (const NamedSet& set : sets) {
+                stream << "\n  " << set.name << ": ";
+                for (unsigned member : set.members) {
+                    stream << member << " ";
+                }
+            }
+            stream << "\n";
+            break;
+        case OutputFormat::JSON:
+            beginJSON(analysis);
+            stream << ",\"block\":" << block;
+            for (const NamedSet& set : sets) {
+                writeJSONArray(set);
+            }
+            stream << "}\n";
+            break;
+        case OutputFormat::Binary:
+            writeByte(BlockSetsRecord);
+            writeString(analysis);
+            write32(block);
+            write32(sets.size());
+            for (const NamedSet& set : sets) {
+                writeSet(set);
+            }
+            break;
+        }
+    }
+
+    // A set attached to one instruction, e.g. the definitions reaching a load (Sets level)
+    void pointSet(StringRef analysis, unsigned instruction, NamedSet set) {
+        if (!enabled(Verbosity::Sets)) {
+            return;
+        }
+        switch (format) {
+        case OutputFormat::Text:
+            stream << "  " << instruction << ": ";
+            for (unsigned member : set.members) {
+                stream << member << " ";
+            }
+            stream << "\n";
+            break;
+        case OutputFormat::JSON:
+            beginJSON(analysis);
+            stream << ",\"instruction\":" << instruction;
+            writeJSONArray(set);
+            stream << "}\n";
+            break;
+        case OutputFormat::Binary:
+            writeByte(PointSetRecord);
+            writeString(analysis);
+            write32(instruction);
+            writeSet(set);
+            break;
+        }
+    }
+
+    // A named count (Summary level). The Text format words its summary
+    // lines itself through textAt(), so this writes nothing there.
+    void counter(StringRef analysis, StringRef name, uint64_t value) {
+        if (!enabled(Verbosity::Summary)) {
+            return;
+        }
+        switch (format) {
+        case OutputFormat::Text:
+            break;
+        case OutputFormat::JSON:
+            beginJSON(analysis);
+            stream << ",";
+            writeJSONString(name);
+            stream << ":" << value << "}\n";
+            break;
+        case OutputFormat::Binary:
+            writeByte(CounterRecord);
+            writeString(analysis);
+            writeString(name);
+            support::endian::write<uint64_t>(stream, value, support::little);
+            break;
+        }
+    }
+
+    // Write everything collected so far to out and start over
+    void flushTo(raw_ostream& out) {
+        out << buffer;
+        buffer.clear();
+    }
+
+    // Written once at the start of an output stream, before any function's results
+    static void writeStreamHeader(raw_ostream& out, OutputFormat format) {
+        if (format == OutputFormat::Binary) {
+            out << "DFR1";
+        }
+    }
+
+private:
+    Verbosity verbosity;
+    OutputFormat format;
+    SmallString<32> functionName;
+    SmallString<0> buffer;
+    raw_svector_ostream stream;
+
+    // Opens a record with the fields every JSON line carries
+    void beginJSON(StringRef analysis) {
+        stream << "{\"function\":";
+        writeJSONString(functionName);
+        stream << ",\"analysis\":";
+        writeJSONString(analysis);
+    }
+
+    void writeJSONString(StringRef text) {
+        stream << '"';
+        for (unsigned char c : text) {
+            if (c == '"' || c == '\\') {
+                stream << '\\' << c;
+            } else if (c < 0x20) {
+                stream << llvm::format("\\u%04x", c);
+            } else {
+                stream << c;
+            }
+        }
+        stream << '"';
+    }
+
+    void writeJSONArray(const NamedSet& set) {
+        stream << ",";
+        writeJSONString(set.name);
+        stream << ":[";
+        for (unsigned i = 0; i < set.members.size(); i++) {
+            stream << (i ? "," : "") << set.members[i];
+        }
+        stream << "]";
+    }
+
+    void writeByte(uint8_t byte) { stream << char(byte); }
+
+    void write32(uint32_t value) { support::endian::write<uint32_t>(stream, value, support::little); }
+
+    void writeString(StringRef text) {
+        write32(text.size());
+        stream << text;
+    }
+
+    void writeSet(const NamedSet& set) {
+        writeString(set.name);
+        write32(set.members.size());
+        for (unsigned member : set.members) {
+            write32(member);
+        }
+    }
+};
+
+class ResultOutput;
+
+// The results one unit of work (in dataflow-driver, one module) wrote to
+// the ResultOutputs while captured, held back so several units can be
+// rendered at once and written out later in a fixed order. Writes are kept
+// in the order they were made, also across outputs sharing a stream.
+class CapturedResults {
+public:
+    raw_ostream& streamFor(ResultOutput& output) {
+        if (chunks.empty() || chunks.back()->output != &output) {
+            chunks.emplace_back(new Chunk(output));
+        }
+        return chunks.back()->stream;
+    }
+
+    // Writes everything to the outputs it was captured from
+    inline void writeToOutputs();
+
+    // Writes everything to out, with the stream header of each output's format before its first chunk
+    inline void writeTo(raw_ostream& out);
+
+private:
+    // A run of writes to the same output
+    struct Chunk {
+        ResultOutput* output;
+        std::string text;
+        raw_string_ostream stream;
+
+        explicit Chunk(ResultOutput& output) : output(&output), stream(text) {}
+    };
+    std::vector<std::unique_ptr<Chunk>> chunks;
+};
+
+// Sends everything written to a ResultOutput on this thread to results while it lives
+class CaptureResults {
+public:
+    explicit CaptureResults(CapturedResults& results) : previous(current()) { current() = &results; }
+    ~CaptureResults() { current() = previous; }
+
+    static CapturedResults*& current() {
+        static thread_local CapturedResults* results = nullptr;
+        return results;
+    }
+
+private:
+    CapturedResults* previous;
+};
+
+// Where a pass sends its results: stderr for "-", otherwise the named file.
+// Results captured on the writing thread go to the capture instead.
+class ResultOutput {
+public:
+    // Fails if the file cannot be created; the pass reports the error, and
+    // until it is opened again the results go to stderr
+    Error open(StringRef path, OutputFormat format) {
+        outputFormat = format;
+        file.reset();
+        if (path != "-") {
+            std::error_code error;
+            file.reset(new raw_fd_ostream(path, error, sys::fs::OF_None));
+            if (error) {
+                file.reset();
+                return createFileError(path, error);
+            }
+        }
+        ResultWriter::writeStreamHeader(target(), format);
+        return Error::success();
+    }
+
+    void close() { file.reset(); }
+
+    raw_ostream& stream() {
+        if (CapturedResults* captured = CaptureResults::current()) {
+            return captured->streamFor(*this);
+        }
+        return target();
+    }
+
+    raw_ostream& target() { return file ? *file : errs(); }
+
+    OutputFormat format() const { return outputFormat; }
+
+private:
+    std::unique_ptr<raw_fd_ostream> file;
+    OutputFormat outputFormat = OutputFormat::Text;
+};
+
+void CapturedResults::writeToOutputs() {
+    for (auto& chunk : chunks) {
+        chunk->output->target() << chunk->stream.str();
+    }
+}
+
+void CapturedResults::writeTo(raw_ostream& out) {
+    std::vector<const ResultOutput*> started;
+    for (auto& chunk : chunks) {
+        if (std::find(started.begin(), started.end(), chunk->output) == started.end()) {
+            started.push_back(chunk->output);
+            ResultWriter::writeStreamHeader(out, chunk->output->format());
+        }
+        out << chunk->stream.str();
+    }
+}
+
+} // end of namespace dataflow
+
+// Trace narration, e.g. DATAFLOW_TRACE(writer, "  Found store to " << name << "\n");
+// The arguments are not even evaluated in release (NDEBUG) builds.
+#ifndef NDEBUG
+#define DATAFLOW_TRACE(writer, output)                                        \
+    do {                                                                      \
+        if (raw_ostream* traceStream = (writer).textAt(dataflow::Verbosity::Trace)) { \
+            *traceStream << output;                                           \
+        }                                                                     \
+    } while (false)
+#else
+#define DATAFLOW_TRACE(writer, output) \
+    do {                               \
+    } while (false)
+#endif
+
+#endif
@@ -0,0 +1,298 @@
+#ifndef CS201_DATAFLOW_SPARSEREACHINGDEFINITIONS_H
+#define CS201_DATAFLOW_SPARSEREACHINGDEFINITIONS_H
+
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/IteratedDominanceFrontier.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "CFGIndex.h"
+#include "DefinitionIndex.h"
+#include "PhaseTimer.h"
+#include <algorithm>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+namespace dataflow {
+
+using namespace llvm;
+
+// Sparse reaching definitions over an SSA-style def-use graph.
+// Each variable is handled on its own: phi points are placed at the iterated
+// dominance frontier of the blocks that define it (minimal SSA, as mem2reg
+// builds it), and the value of a variable at a point is found by walking up
+// the dominator tree to the nearest block that defines it or holds one of its
+// phis. Only the phis are iterated to a fixpoint, so the work is proportional
+// to definitions, phis and the points actually queried instead of
+// blocks x definitions. Answers are the same as ReachingDefinitionSets.
+class SparseReachingDefinitions : public DefinitionIndex {
+public:
+    void compute(Function& F, const CFGIndex& cfgIndex, DominatorTree& dominators) {
+        cfg = &cfgIndex;
+        DT = &dominators;
+        phis.clear();
+        phiAt.clear();
+        lastDefInBlock.clear();
+        entryNames.clear();
+
+        PhaseTimer phases("sparse-reaching-definitions", "Sparse reaching definitions", F.getName());
+        phases.start("srd-index", "Number the definitions");
+        buildIndex(F, cfgIndex);
+        unsigned numDefs = definitions.size();
+        for (unsigned defIndex = 0; defIndex < numDefs; defIndex++) {
+            // Definitions are in program order, so the last one seen in a block wins
+            lastDefInBlock[{definitionVariable[defIndex], definitionBlock[defIndex]}] = defIndex;
+        }
+
+        // Place phis at the iterated dominance frontier of each variable's defining blocks
+        phases.start("srd-phis", "Place and connect the phis");
+        ForwardIDFCalculator IDF(dominators);
+        SmallPtrSet<BasicBlock*, 32> defBlocks;
+        SmallVector<BasicBlock*, 32> phiBlocks;
+        for (unsigned variable = 0; variable < variables.size(); variable++) {
+            defBlocks.clear();
+            for (unsigned defIndex : variableDefs[variable]) {
+                if (cfgIndex.isReachable(definitionBlock[defIndex])) {
+                    defBlocks.insert(cfgIndex.blocks[definitionBlock[defIndex]]);
+                }
+            }
+            phiBlocks.clear();
+            IDF.setDefiningBlocks(defBlocks);
+            IDF.calculate(phiBlocks);
+            for (BasicBlock* phiBlock : phiBlocks) {
+                unsigned blockNum = cfgIndex.number(phiBlock);
+                phiAt[{variable, blockNum}] = phis.size();
+                phis.push_back({variable, blockNum, {}, {}});
+            }
+        }
+
+        // Connect each phi to the value of its variable at the end of every reachable predecessor
+        std::vector<SmallVector<unsigned, 4>> phiUsers(phis.size());
+        for (unsigned phiId = 0; phiId < phis.size(); phiId++) {
+            for (unsigned pred : cfgIndex.preds(phis[phiId].block)) {
+                unsigned name = nameAtExit(phis[phiId].variable, pred);
+                if (name == NoDefinition) {
+                    continue;
+                }
+                phis[phiId].incoming.push_back(name);
+                if (isPhiName(name)) {
+                    phiUsers[name - numDefs].push_back(phiId);
+                }
+            }
+        }
+
+        // A phi's reaching set is the union over its incoming values
+        phases.start("srd-solve", "Solve the phis");
+        std::vector<unsigned> worklist;
+        std::vector<bool> onWorklist(phis.size(), true);
+        for (unsigned phiId = phis.size(); phiId-- > 0;) {
+            worklist.push_back(phiId);
+        }
+        iterations = 0;
+        SmallVector<unsigned, 8> merged;
+        while (!worklist.empty()) {
+            unsigned phiId = worklist.back();
+            worklist.pop_back();
+            onWorklist[phiId] = false;
+            iterations++;
+
+            merged.clear();
+            for (unsigned name : phis[phiId].incoming) {
+                appendDefs(name, merged);
+            }
+            std::sort(merged.begin(), merged.end());
+            merged.erase(std::unique(merged.begin(), merged.end()), merged.end());
+            if (merged == phis[phiId].reaching) {
+                continue;
+            }
+            phis[phiId].reaching.assign(merged.begin(), merged.end());
+            for (unsigned user : phiUsers[phiId]) {
+                if (!onWorklist[user]) {
+                    onWorklist[user] = true;
+                    worklist.push_back(user);
+                }
+            }
+        }
+    }
+
+    unsigned numPhis() const { return phis.size(); }
+
+    // Definitions of a variable reaching the entry and exit of a block, in ascending order
+    void reachingAtEntry(unsigned variable, unsigned blockNum, SmallVectorImpl<unsigned>& defs) {
+        appendDefs(nameAtEntry(variable, blockNum), defs);
+    }
+
+    void reachingAtExit(unsigned variable, unsigned blockNum, SmallVectorImpl<unsigned>& defs) {
+        appendDefs(nameAtExit(variable, blockNum), defs);
+    }
+
+    // Definitions reaching a load of a variable (the per-use query)
+    void reachingAtLoad(const LoadInst* load, SmallVectorImpl<unsigned>& defs) {
+        unsigned variable = variableOf(load->getPointerOperand());
+        unsigned blockNum = cfg->number(load->getParent());
+        if (variable == ~0U || !cfg->isReachable(blockNum)) {
+            return;
+        }
+        // The nearest earlier store to the variable in the same block wins
+        const std::vector<unsigned>& varDefs = variableDefs[variable];
+        auto blockEnd = std::upper_bound(varDefs.begin(), varDefs.end(), blockNum,
+                                         [this](unsigned block, unsigned defIndex) { return block < definitionBlock[defIndex]; });
+        for (auto it = blockEnd; it != varDefs.begin();) {
+            --it;
+            if (definitionBlock[*it] != blockNum) {
+                break;
+            }
+            if (definitions[*it]->comesBefore(load)) {
+                defs.push_back(*it);
+                return;
+            }
+        }
+        reachingAtEntry(variable, blockNum, defs);
+    }
+
+    // Whole-block sets in the same shape as the dense engine, built on demand for printing
+    BitVector blockIn(unsigned blockNum) {
+        BitVector IN(definitions.size());
+        SmallVector<unsigned, 8> defs;
+        for (unsigned variable = 0; variable < variables.size(); variable++) {
+            defs.clear();
+            reachingAtEntry(variable, blockNum, defs);
+            for (unsigned defIndex : defs) {
+                IN.set(defIndex);
+            }
+        }
+        return IN;
+    }
+
+    BitVector blockOut(unsigned blockNum) {
+        BitVector OUT(definitions.size());
+        SmallVector<unsigned, 8> defs;
+        for (unsigned variable = 0; variable < variables.size(); variable++) {
+            defs.clear();
+            reachingAtExit(variable, blockNum, defs);
+            for (unsigned defIndex : defs) {
+                OUT.set(defIndex);
+            }
+        }
+        return OUT;
+    }
+
+    // GEN is the last store to each variable in the block; KILL is every
+    // other definition of the variables the block writes
+    BitVector blockGen(unsigned blockNum) const {
+        BitVector GEN(definitions.size());
+        auto blockDefs = std::equal_range(definitionBlock.begin(), definitionBlock.end(), blockNum);
+        for (auto it = blockDefs.first; it != blockDefs.second; ++it) {
+            unsigned defIndex = it - definitionBlock.begin();
+            if (lastDefInBlock.lookup({definitionVariable[defIndex], blockNum}) == defIndex) {
+                GEN.set(defIndex);
+            }
+        }
+        return GEN;
+    }
+
+    BitVector blockKill(unsigned blockNum) const {
+        BitVector GEN = blockGen(blockNum);
+        BitVector KILL(definitions.size());
+        for (unsigned defIndex : GEN.set_bits()) {
+            for (unsigned otherDef : variableDefs[definitionVariable[defIndex]]) {
+                KILL.set(otherDef);
+            }
+        }
+        KILL.reset(GEN);
+        return KILL;
+    }
+
+    unsigned iterations = 0; // Phi visits needed to reach the fixpoint
+
+private:
+    // The value of a variable at a point is a "name": a definition index, a
+    // phi (numDefinitions() + phi id) or NoDefinition
+    static const unsigned NoDefinition = ~0U;
+
+    struct Phi {
+        unsigned variable;
+        unsigned block;
+        SmallVector<unsigned, 4> incoming; // Names flowing in from the predecessors
+        SmallVector<unsigned, 4> reaching; // Definitions reaching the phi, ascending
+    };
+
+    const CFGIndex* cfg = nullptr;
+    DominatorTree* DT = nullptr;
+    std::vector<Phi> phis;
+    DenseMap<std::pair<unsigned, unsigned>, unsigned> phiAt;          // (variable, block) -> phi id
+    DenseMap<std::pair<unsigned, unsigned>, unsigned> lastDefInBlock; // (variable, block) -> last definition
+    DenseMap<std::pair<unsigned, unsigned>, unsigned> entryNames;     // (variable, block) -> name at entry
+
+    bool isPhiName(unsigned name) const { return name != NoDefinition && name >= definitions.size(); }
+
+    void appendDefs(unsigned name, SmallVectorImpl<unsigned>& defs) const {
+        if (name == NoDefinition) {
+            return;
+        }
+        if (isPhiName(name)) {
+            const auto& reaching = phis[name - definitions.size()].reaching;
+            defs.append(reaching.begin(), reaching.end());
+        } else {
+            defs.push_back(name);
+        }
+    }
+
+    unsigned nameAtExit(unsigned variable, unsigned blockNum) {
+        if (!cfg->isReachable(blockNum)) {
+            return NoDefinition;
+        }
+        auto lastDef = lastDefInBlock.find({variable, blockNum});
+        if (lastDef != lastDefInBlock.end()) {
+            return lastDef->second;
+        }
+        return nameAtEntry(variable, blockNum);
+    }
+
+    // Walk up the dominator tree to the nearest phi or defining block, caching
+    // the answer for every block passed on the way
+    unsigned nameAtEntry(unsigned variable, unsigned blockNum) {
+        if (!cfg->isReachable(blockNum)) {
+            return NoDefinition;
+        }
+        SmallVector<unsigned, 16> walked;
+        unsigned name = NoDefinition;
+        unsigned walk = blockNum;
+        while (true) {
+            auto cached = entryNames.find({variable, walk});
+            if (cached != entryNames.end()) {
+                name = cached->second;
+                break;
+            }
+            walked.push_back(walk);
+            auto phi = phiAt.find({variable, walk});
+            if (phi != phiAt.end()) {
+                name = definitions.size() + phi->second;
+                break;
+            }
+            DomTreeNode* idom = DT->getNode(cfg->blocks[walk])->getIDom();
+            if (!idom) {
+                break; // Reached the entry block without a definition
+            }
+            unsigned idomNum = cfg->number(idom->getBlock());
+            auto lastDef = lastDefInBlock.find({variable, idomNum});
+            if (lastDef != lastDefInBlock.end()) {
+                name = lastDef->second;
+                break;
+            }
+            walk = idomNum;
+        }
+        for (unsigned block : walked) {
+            entryNames[{variable, block}] = name;
+        }
+        return name;
+    }
+};
+
+} // end of namespace dataflow
+
+#endif
@@ -0,0 +1,469 @@
+#ifndef CS201_DATAFLOW_VALUENUMBERING_H
+#define CS201_DATAFLOW_VALUENUMBERING_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseMapInfo.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/InstrTypes.h"
+#include "llvm/IR/Instruction.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/ModuleSlotTracker.h"
+#include "llvm/IR/Type.h"
+#include "llvm/IR/Value.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace dataflow {
+
+using namespace llvm;
+using std::vector;
+
+// Streams a value the way it appears as an operand, e.g. "%b" or "%2". Pass a
+// slot tracker when printing many values of one function; without one every
+// unnamed value numbers the whole function again.
+struct AsOperand {
+    const Value* value;
+    ModuleSlotTracker* slots;
+
+    explicit AsOperand(const Value* value, ModuleSlotTracker* slots = nullptr) : value(value), slots(slots) {}
+};
+
+inline raw_ostream& operator<<(raw_ostream& out, AsOperand operand) {
+    if (!operand.value) {
+        return out << "<none>";
+    }
+    if (operand.slots) {
+        operand.value->printAsOperand(out, false, *operand.slots);
+    } else {
+        operand.value->printAsOperand(out, false);
+    }
+    return out;
+}
+
+// An operand of an expression: either a leaf, which is a Value (the variable
+// for a load of a tracked variable, else the operand itself), or another
+// expression by number. Values are aligned, so the low bit tells them apart.
+using OperandId = uintptr_t;
+
+inline OperandId leafOperand(const Value* value) { return reinterpret_cast<OperandId>(value); }
+inline OperandId expressionOperand(unsigned number) { return (OperandId(number) << 1) | 1; }
+inline bool isExpressionOperand(OperandId operand) { return operand & 1; }
+inline unsigned operandExpression(OperandId operand) { return unsigned(operand >> 1); }
+inline const Value* operandLeaf(OperandId operand) { return reinterpret_cast<const Value*>(operand); }
+
+// What makes two computations the same expression: the opcode, the icmp
+// predicate, the types and the value numbers of the operands. Commutative
+// operands and icmp operands are put in a canonical order, so a + b and b + a
+// (or a < b and b > a) have the same key. Flags like nsw/nuw, exact and
+// inbounds are not part of it; they are intersected when one computation
+// replaces another.
+struct ExpressionKey {
+    static const unsigned MaxOperands = 3; // A getelementptr with more indices is not numbered
+
+    unsigned opcode = 0;
+    unsigned predicate = 0;             // ICmpInst predicate, 0 for other opcodes
+    const Type* type = nullptr;         // Result type
+    const Type* sourceType = nullptr;   // Type a getelementptr indexes into, null for other opcodes
+    unsigned numOperands = 0;
+    OperandId operands[MaxOperands] = {};
+
+    bool operator==(const ExpressionKey& key) const {
+        return opcode == key.opcode && predicate == key.predicate && type == key.type && sourceType == key.sourceType &&
+               numOperands == key.numOperands && std::equal(operands, operands + numOperands, key.operands);
+    }
+
+    bool operator!=(const ExpressionKey& key) const { return !(*this == key); }
+};
+
+} // end of namespace dataflow
+
+namespace llvm {
+// Lets ExpressionKey be used as a DenseMap key
+template <> struct DenseMapInfo<dataflow::ExpressionKey> {
+    static dataflow::ExpressionKey getEmptyKey() {
+        dataflow::ExpressionKey key;
+        key.opcode = ~0U;
+        return key;
+    }
+    static dataflow::ExpressionKey getTombstoneKey() {
+        dataflow::ExpressionKey key;
+        key.opcode = ~0U - 1;
+        return key;
+    }
+    static unsigned getHashValue(const dataflow::ExpressionKey& key) {
+        return hash_combine(key.opcode, key.predicate, key.type, key.sourceType,
+                            hash_combine_range(key.operands, key.operands + key.numOperands));
+    }
+    static bool isEqual(const dataflow::ExpressionKey& lhs, const dataflow::ExpressionKey& rhs) { return lhs == rhs; }
+};
+} // end of namespace llvm
+
+namespace dataflow {
+
+inline const char* opcodeSymbol(unsigned opcode) {
+    switch (opcode) {
+    case Instruction::Add:
+        return "+";
+    case Instruction::Sub:
+        return "-";
+    case Instruction::Mul:
+        return "*";
+    case Instruction::SDiv:
+        return "/";
+    case Instruction::UDiv:
+        return "/u";
+    case Instruction::SRem:
+        return "%";
+    case Instruction::URem:
+        return "%u";
+    case Instruction::Shl:
+        return "<<";
+    case Instruction::AShr:
+        return ">>";
+    case Instruction::LShr:
+        return ">>u";
+    case Instruction::And:
+        return "&";
+    case Instruction::Or:
+        return "|";
+    case Instruction::Xor:
+        return "^";
+    default:
+        return "?";
+    }
+}
+
+// Whether an alloca is a variable whose every use is a plain load or store of
+// it, so nothing but those stores can change its value
+inline bool isTrackedVariable(const AllocaInst& alloca) {
+    return std::all_of(alloca.user_begin(), alloca.user_end(), [&](const User* user) {
+        if (const auto* load = dyn_cast<LoadInst>(user)) {
+            return !load->isVolatile();
+        }
+        const auto* store = dyn_cast<StoreInst>(user);
+        return store && !store->isVolatile() && store->getPointerOperand() == &alloca &&
+               store->getValueOperand() != &alloca;
+    });
+}
+
+// Value numbering of the computations of a function.
+// Every integer binary operator, icmp, cast and getelementptr gets the number
+// of its expression, numbered in order of first occurrence. Operands are
+// numbered too: a load of a tracked variable is the variable, and an operand
+// computed earlier in the same block is its expression, as long as nothing it
+// reads was stored to in between. Anything else is a leaf of its own, so the
+// expressions of a block nest, e.g. (a + b) * c.
+//
+// Only allocas whose every use is a plain load or store are tracked, so a
+// store to one is the only way an expression reading it changes value.
+struct ValueNumbering {
+    vector<ExpressionKey> keys;                // Expression number -> key
+    vector<const Instruction*> representatives; // Expression number -> its first computation
+    vector<unsigned> firstIndex;                // Expression number -> instruction index of its first computation
+    DenseMap<ExpressionKey, unsigned> numbers;
+    DenseMap<const Instruction*, unsigned> instructionNumbers;
+    // The tracked variables each expression reads, directly or through its operands:
+    // readLocations[readOffsets[e] .. readOffsets[e + 1])
+    vector<unsigned> readOffsets;
+    vector<const Value*> readLocations;
+    // The reverse, expressions by the variable they read, so a store finds what it kills:
+    // readerIndices[readerOffsets[l] .. readerOffsets[l + 1]) for location number l
+    DenseMap<const Value*, unsigned> locationNumbers;
+    vector<unsigned> readerOffsets;
+    vector<unsigned> readerIndices;
+
+    ValueNumbering() = default;
+    explicit ValueNumbering(Function& F) { build(F); }
+
+    unsigned size() const { return keys.size(); }
+
+    // Number of the expression inst computes, or -1 if it is not numbered
+    int numberOf(const Instruction& inst) const {
+        auto found = instructionNumbers.find(&inst);
+        return found == instructionNumbers.end() ? -1 : int(found->second);
+    }
+
+    bool isTracked(const Value* location) const { return tracked.count(location); }
+
+    // The tracked variables expression number reads
+    ArrayRef<const Value*> locationsRead(unsigned number) const {
+        return ArrayRef<const Value*>(readLocations).slice(readOffsets[number], readOffsets[number + 1] - readOffsets[number]);
+    }
+
+    // The expressions a store to location kills
+    ArrayRef<unsigned> expressionsReading(const Value* location) const {
+        auto found = locationNumbers.find(location);
+        if (found == locationNumbers.end()) {
+            return {};
+        }
+        return ArrayRef<unsigned>(readerIndices).slice(readerOffsets[found->second],
+                                                       readerOffsets[found->second + 1] - readerOffsets[found->second]);
+    }
+
+    // Maps the expression numbers of an earlier numbering of the same function
+    // to this one: old number -> number of the same expression here, or ~0U if
+    // nothing computes it any more. Keys nest by number, so each old key is
+    // translated operand by operand, in number order (operands come first), and
+    // put in canonical order again. Leaves are compared by address, so an
+    // instruction freed since the old numbering was built must not have been
+    // reused by one created after it.
+    vector<unsigned> renumbering(const ValueNumbering& old) const {
+        vector<unsigned> remap(old.size(), ~0U);
+        for (unsigned oldNumber = 0; oldNumber < old.size(); oldNumber++) {
+            ExpressionKey key = old.keys[oldNumber];
+            bool translated = true;
+            for (unsigned i = 0; i < key.numOperands; i++) {
+                if (isExpressionOperand(key.operands[i])) {
+                    unsigned number = remap[operandExpression(key.operands[i])];
+                    translated &= number != ~0U;
+                    key.operands[i] = expressionOperand(number);
+                }
+            }
+            if (!translated) {
+                continue;
+            }
+            canonicalize(key);
+            auto found = numbers.find(key);
+            if (found != numbers.end()) {
+                remap[oldNumber] = found->second;
+            }
+        }
+        return remap;
+    }
+
+    // Operand i of expression number, in the order of its first computation's operands
+    OperandId operandAt(unsigned number, unsigned i) const {
+        const ExpressionKey& key = keys[number];
+        return swapped[number] ? key.operands[1 - i] : key.operands[i];
+    }
+
+    void build(Function& F) {
+        keys.clear();
+        representatives.clear();
+        firstIndex.clear();
+        swapped.clear();
+        numbers.clear();
+        instructionNumbers.clear();
+        readOffsets.assign(1, 0);
+        readLocations.clear();
+        findTrackedLocations(F);
+
+        unsigned index = 0;
+        for (auto& basic_block : F) {
+            positions.clear();
+            lastStore.clear();
+            for (auto& inst : basic_block) {
+                if (const auto* store = dyn_cast<StoreInst>(&inst)) {
+                    if (isTracked(store->getPointerOperand())) {
+                        lastStore[store->getPointerOperand()] = index + 1;
+                    }
+                } else if (const auto* load = dyn_cast<LoadInst>(&inst)) {
+                    if (isTracked(load->getPointerOperand())) {
+                        positions[&inst] = index;
+                    }
+                } else {
+                    ExpressionKey key;
+                    if (keyOf(inst, key)) {
+                        instructionNumbers[&inst] = intern(key, inst, index);
+                        positions[&inst] = index;
+                    }
+                }
+                index++;
+            }
+        }
+        buildReaders();
+    }
+
+    // Prints expression number as its first computation wrote it, e.g. "%a + %b";
+    // an operand that is itself an expression is printed as the value computing it
+    void print(raw_ostream& out, unsigned number, ModuleSlotTracker* slots = nullptr) const {
+        const ExpressionKey& key = keys[number];
+        const Instruction& inst = *representatives[number];
+        OperandId operands[ExpressionKey::MaxOperands];
+        for (unsigned i = 0; i < key.numOperands; i++) {
+            operands[i] = operandAt(number, i);
+        }
+        auto printOperand = [&](OperandId operand) {
+            if (isExpressionOperand(operand)) {
+                out << "(" << AsOperand(representatives[operandExpression(operand)], slots) << ")";
+            } else {
+                out << AsOperand(operandLeaf(operand), slots);
+            }
+        };
+        if (isa<BinaryOperator>(inst)) {
+            printOperand(operands[0]);
+            out << " " << opcodeSymbol(key.opcode) << " ";
+            printOperand(operands[1]);
+        } else if (const auto* cmp = dyn_cast<ICmpInst>(&inst)) {
+            printOperand(operands[0]);
+            out << " " << CmpInst::getPredicateName(cmp->getPredicate()) << " ";
+            printOperand(operands[1]);
+        } else if (isa<CastInst>(inst)) {
+            out << inst.getOpcodeName() << " ";
+            printOperand(operands[0]);
+            out << " to " << *inst.getType();
+        } else {
+            out << inst.getOpcodeName();
+            for (unsigned i = 0; i < key.numOperands; i++) {
+                out << (i == 0 ? " " : ", ");
+                printOperand(operands[i]);
+            }
+        }
+    }
+
+private:
+    SmallPtrSet<const Value*, 16> tracked;
+    vector<bool> swapped; // Expression number -> whether its first computation's operands are in the other order
+    // Per-block state of build(): where each load and numbered computation is, and the
+    // position after the last store to each variable
+    DenseMap<const Instruction*, unsigned> positions;
+    DenseMap<const Value*, unsigned> lastStore;
+
+    void findTrackedLocations(Function& F) {
+        tracked.clear();
+        for (auto& inst : instructions(F)) {
+            const auto* alloca = dyn_cast<AllocaInst>(&inst);
+            if (alloca && isTrackedVariable(*alloca)) {
+                tracked.insert(alloca);
+            }
+        }
+    }
+
+    // Value number of an operand at the current point of build()
+    OperandId operandOf(const Value* value) const {
+        const auto* inst = dyn_cast<Instruction>(value);
+        auto position = inst ? positions.find(inst) : positions.end();
+        if (position == positions.end()) {
+            return leafOperand(value); // Constant, argument, or computed somewhere we do not look into
+        }
+        if (const auto* load = dyn_cast<LoadInst>(inst)) {
+            const Value* location = load->getPointerOperand();
+            return lastStore.lookup(location) > position->second ? leafOperand(value) : leafOperand(location);
+        }
+        unsigned number = instructionNumbers.lookup(inst);
+        for (const Value* location : locationsRead(number)) {
+            if (lastStore.lookup(location) > position->second) {
+                return leafOperand(value); // A variable it read changed since, so its value is its own
+            }
+        }
+        return expressionOperand(number);
+    }
+
+    bool keyOf(const Instruction& inst, ExpressionKey& key) const {
+        switch (inst.getOpcode()) {
+        case Instruction::Add:
+        case Instruction::Sub:
+        case Instruction::Mul:
+        case Instruction::UDiv:
+        case Instruction::SDiv:
+        case Instruction::URem:
+        case Instruction::SRem:
+        case Instruction::Shl:
+        case Instruction::LShr:
+        case Instruction::AShr:
+        case Instruction::And:
+        case Instruction::Or:
+        case Instruction::Xor:
+            break;
+        case Instruction::ICmp:
+            key.predicate = cast<ICmpInst>(inst).getPredicate();
+            break;
+        case Instruction::GetElementPtr:
+            if (inst.getNumOperands() > ExpressionKey::MaxOperands) {
+                return false;
+            }
+            key.sourceType = cast<GetElementPtrInst>(inst).getSourceElementType();
+            break;
+        default:
+            if (!isa<CastInst>(inst)) {
+                return false;
+            }
+        }
+        key.opcode = inst.getOpcode();
+        key.type = inst.getType();
+        key.numOperands = inst.getNumOperands();
+        for (unsigned i = 0; i < key.numOperands; i++) {
+            key.operands[i] = operandOf(inst.getOperand(i));
+        }
+        canonicalize(key);
+        return true;
+    }
+
+    // Puts commutative and icmp operands in ascending order, swapping the predicate to match
+    static void canonicalize(ExpressionKey& key) {
+        bool isCompare = key.opcode == Instruction::ICmp;
+        if ((Instruction::isCommutative(key.opcode) || isCompare) && key.operands[1] < key.operands[0]) {
+            std::swap(key.operands[0], key.operands[1]);
+            if (isCompare) {
+                key.predicate = CmpInst::getSwappedPredicate(CmpInst::Predicate(key.predicate));
+            }
+        }
+    }
+
+    // Number of key, numbering it if it is new
+    unsigned intern(const ExpressionKey& key, const Instruction& inst, unsigned index) {
+        auto inserted = numbers.insert({key, unsigned(keys.size())});
+        if (!inserted.second) {
+            return inserted.first->second;
+        }
+        keys.push_back(key);
+        representatives.push_back(&inst);
+        firstIndex.push_back(index);
+        swapped.push_back(key.numOperands == 2 && key.operands[0] != operandOf(inst.getOperand(0)));
+        // Tracked variables appear as leaves only for loads, since their only other uses are stores
+        unsigned start = readLocations.size();
+        auto addRead = [&](const Value* location) {
+            if (std::find(readLocations.begin() + start, readLocations.end(), location) == readLocations.end()) {
+                readLocations.push_back(location);
+            }
+        };
+        for (unsigned i = 0; i < key.numOperands; i++) {
+            if (isExpressionOperand(key.operands[i])) {
+                // By index: addRead may grow readLocations under an ArrayRef into it
+                unsigned operand = operandExpression(key.operands[i]);
+                for (unsigned j = readOffsets[operand]; j < readOffsets[operand + 1]; j++) {
+                    addRead(readLocations[j]);
+                }
+            } else if (isTracked(operandLeaf(key.operands[i]))) {
+                addRead(operandLeaf(key.operands[i]));
+            }
+        }
+        readOffsets.push_back(readLocations.size());
+        return inserted.first->second;
+    }
+
+    // Counting sort of the expressions by the locations they read
+    void buildReaders() {
+        locationNumbers.clear();
+        readerOffsets.assign(1, 0);
+        for (const Value* location : readLocations) {
+            auto inserted = locationNumbers.insert({location, unsigned(readerOffsets.size() - 1)});
+            if (inserted.second) {
+                readerOffsets.push_back(0);
+            }
+            readerOffsets[inserted.first->second + 1]++;
+        }
+        for (unsigned l = 1; l < readerOffsets.size(); l++) {
+            readerOffsets[l] += readerOffsets[l - 1];
+        }
+        readerIndices.resize(readerOffsets.back());
+        vector<unsigned> next(readerOffsets.begin(), readerOffsets.end() - 1);
+        for (unsigned number = 0; number < keys.size(); number++) {
+            for (const Value* location : locationsRead(number)) {
+                readerIndices[next[locationNumbers[location]]++] = number;
+            }
+        }
+    }
+};
+
+} // end of namespace dataflow
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef CS201_DATAFLOW_WORKSTEALINGPOOL_H
+#define CS201_DATAFLOW_WORKSTEALINGPOOL_H
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace dataflow {
+
+// Runs a batch of independent tasks on a fixed number of threads.
+// Tasks are dealt to per-worker queues round-robin in the order given, so
+// callers pass the most expensive tasks first. Each worker takes from the
+// front of its own queue and, once that runs dry, steals from the back of
+// the other workers' queues, so one oversized task does not leave the rest
+// of the batch waiting behind it.
+class WorkStealingPool {
+public:
+    using Task = std::function<void()>;
+
+    // 0 threads means one per hardware thread
+    explicit WorkStealingPool(unsigned threads) : numThreads(threads) {
+        if (numThreads == 0) {
+            numThreads = std::max(1U, std::thread::hardware_concurrency());
+        }
+    }
+
+    unsigned size() const { return numThreads; }
+
+    // Returns once every task has finished
+    void run(std::vector<Task> tasks) {
+        unsigned numWorkers = std::min<size_t>(numThreads, tasks.size());
+        if (numWorkers <= 1) {
+            for (Task& task : tasks) {
+                task();
+            }
+            return;
+        }
+
+        queues.clear();
+        for (unsigned i = 0; i < numWorkers; i++) {
+            queues.emplace_back(new WorkerQueue());
+        }
+        for (size_t i = 0; i < tasks.size(); i++) {
+            queues[i % numWorkers]->tasks.push_back(std::move(tasks[i]));
+        }
+
+        // The calling thread works as worker 0
+        std::vector<std::thread> threads;
+        for (unsigned i = 1; i < numWorkers; i++) {
+            threads.emplace_back([this, i] { work(i); });
+        }
+        work(0);
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        queues.clear();
+    }
+
+private:
+    struct WorkerQueue {
+        std::mutex lock;
+        std::deque<Task> tasks;
+    };
+
+    unsigned numThreads;
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+
+    // No task is added once the batch starts, so a worker that finds every
+    // queue empty is done
+    void work(unsigned self) {
+        Task task;
+        while (popOwn(self, task) || steal(self, task)) {
+            task();
+        }
+    }
+
+    bool popOwn(unsigned self, Task& task) {
+        WorkerQueue& queue = *queues[self];
+        std::lock_guard<std::mutex> guard(queue.lock);
+        if (queue.tasks.empty()) {
+            return false;
+        }
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        return true;
+    }
+
+    bool steal(unsigned self, Task& task) {
+        for (unsigned offset = 1; offset < queues.size(); offset++) {
+            WorkerQueue& victim = *queues[(self + offset) % queues.size()];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.back());
+                victim.tasks.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+} // end of namespace dataflow
+
+#endif
@@ -0,0 +1,388 @@
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/DiagnosticInfo.h"
+#include "llvm/IR/DiagnosticPrinter.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Support/raw_ostream.h"
+#include "BoundedQueue.h"
+#include "DataflowAnalyses.h"
+#include "PhaseTimer.h"
+#include "ResultWriter.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace llvm;
+
+static cl::list<std::string> InputFilenames(cl::Positional, cl::OneOrMore, cl::desc("<.bc/.ll files, or @file with one per line>"));
+static cl::opt<std::string> Passes("passes", cl::Required, cl::value_desc("pipeline"),
+                                   cl::desc("Function pass pipeline, e.g. 'print<reaching-definitions>,cse-elimination'"));
+static cl::opt<std::string> OutputDirectory("o", cl::value_desc("directory"),
+                                            cl::desc("Write every whole module to this directory: a changed one serialized "
+                                                     "again, an unchanged one copied if already in the output format "
+                                                     "(default: only the results)"));
+static cl::opt<bool> EmitText("S", cl::desc("Write textual IR instead of bitcode"));
+static cl::opt<std::string> ResultsDirectory("results-dir", cl::value_desc("directory"),
+                                             cl::desc("Write each module's results to <directory>/<input name>.out "
+                                                      "instead of -rd-output and -cse-output"));
+static cl::list<std::string> OnlyFunctions("function", cl::CommaSeparated, cl::value_desc("name"),
+                                           cl::desc("Only load and run on these functions"));
+static cl::opt<unsigned> Jobs("j", cl::init(1), cl::desc("Modules analyzed at once (0 = one per hardware thread)"));
+static cl::opt<unsigned> LoadJobs("load-jobs", cl::init(1), cl::desc("Threads reading and parsing modules when -j is not 1"));
+static cl::opt<unsigned> QueueSize("queue-size", cl::init(0),
+                                   cl::desc("Modules waiting between two stages (default: as many as -j)"));
+
+namespace {
+
+// A module on its way from its input file to its results
+struct ModuleJob {
+    std::string path;
+    std::unique_ptr<LLVMContext> context; // Its own, so modules on different threads share nothing
+    std::unique_ptr<Module> M;
+    bool bitcodeInput = false;
+    bool changed = false;
+    std::string error; // Set by the stage that failed, or by a pass reporting an error
+    dataflow::CapturedResults results;
+};
+
+// Errors a pass reports on the module, such as a result file it could not
+// open, fail the job instead of exiting the process. The first one is kept.
+struct JobDiagnosticHandler : DiagnosticHandler {
+    ModuleJob& job;
+
+    explicit JobDiagnosticHandler(ModuleJob& job) : job(job) {}
+
+    bool handleDiagnostics(const DiagnosticInfo& info) override {
+        if (info.getSeverity() != DS_Error) {
+            return false;
+        }
+        if (job.error.empty()) {
+            raw_string_ostream out(job.error);
+            DiagnosticPrinterRawOStream printer(out);
+            info.print(printer);
+        }
+        return true;
+    }
+};
+
+// One worker's analysis managers, cleared after every module
+struct Analyses {
+    LoopAnalysisManager LAM;
+    FunctionAnalysisManager FAM;
+    CGSCCAnalysisManager CGAM;
+    ModuleAnalysisManager MAM;
+
+    explicit Analyses(PassBuilder& PB) {
+        PB.registerModuleAnalyses(MAM);
+        PB.registerCGSCCAnalyses(CGAM);
+        PB.registerFunctionAnalyses(FAM);
+        PB.registerLoopAnalyses(LAM);
+        PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+    }
+};
+
+// The pipeline, built once. Workers share the passes, which keep no state
+// between functions other than where their results go, and that is captured
+// per module whenever more than one module is analyzed at a time.
+struct Pipeline {
+    PassBuilder PB;
+    FunctionPassManager FPM;
+    StringSet<> onlyFunctions;
+
+    // Returns false with a message on errs() if the pipeline text does not parse
+    bool build() {
+        dataflow::registerReachingDefinitionPasses(PB);
+        dataflow::registerCSEliminationPasses(PB);
+        if (Error error = PB.parsePassPipeline(FPM, Passes)) {
+            errs() << "dataflow-driver: " << toString(std::move(error)) << "\n";
+            return false;
+        }
+        onlyFunctions.insert(OnlyFunctions.begin(), OnlyFunctions.end());
+        return true;
+    }
+
+    bool selects(const Function& F) const {
+        return !F.isDeclaration() && (onlyFunctions.empty() || onlyFunctions.count(F.getName()));
+    }
+};
+
+bool fail(StringRef path, const Twine& message) {
+    errs() << "dataflow-driver: " << path << ": " << message << "\n";
+    return false;
+}
+
+// Load stage: reads the input and the bodies of the functions the pipeline
+// runs on. Bitcode is loaded lazily, so the bodies of functions -function
+// leaves out are never read.
+bool load(ModuleJob& job, const Pipeline& pipeline) {
+    ErrorOr<std::unique_ptr<MemoryBuffer>> buffer = MemoryBuffer::getFile(job.path);
+    if (!buffer) {
+        job.error = buffer.getError().message();
+        return false;
+    }
+    job.context = std::make_unique<LLVMContext>();
+    job.context->setDiagnosticHandler(std::make_unique<JobDiagnosticHandler>(job));
+    job.bitcodeInput = isBitcode(reinterpret_cast<const unsigned char*>((*buffer)->getBufferStart()),
+                                 reinterpret_cast<const unsigned char*>((*buffer)->getBufferEnd()));
+    if (job.bitcodeInput) {
+        Expected<std::unique_ptr<Module>> lazy = getOwningLazyBitcodeModule(std::move(*buffer), *job.context);
+        if (!lazy) {
+            job.error = toString(lazy.takeError());
+            return false;
+        }
+        job.M = std::move(*lazy);
+    } else {
+        SMDiagnostic diagnostic;
+        job.M = parseIR((*buffer)->getMemBufferRef(), diagnostic, *job.context);
+        if (!job.M) {
+            job.error = (Twine(diagnostic.getLineNo()) + ":" + Twine(diagnostic.getColumnNo() + 1) + ": " +
+                         diagnostic.getMessage()).str();
+            return false;
+        }
+    }
+    for (Function& F : *job.M) {
+        if (!pipeline.selects(F)) {
+            continue;
+        }
+        if (Error error = F.materialize()) {
+            job.error = toString(std::move(error));
+            return false;
+        }
+    }
+    return true;
+}
+
+// Analysis stage: runs the pipeline on every selected function, dropping each
+// function's analyses as soon as its passes are done. Stops at the first error
+// a pass reports.
+void analyze(ModuleJob& job, Pipeline& pipeline, Analyses& analyses) {
+    for (Function& F : *job.M) {
+        if (!pipeline.selects(F)) {
+            continue;
+        }
+        if (!job.error.empty()) {
+            break;
+        }
+        job.changed |= !pipeline.FPM.run(F, analyses.FAM).areAllPreserved();
+        analyses.FAM.clear(F, F.getName());
+    }
+    analyses.MAM.clear();
+}
+
+// Output stage: writes the captured results, then with -o the module. A
+// module no pass changed is copied as it came in, and only a changed one is
+// written out again. Returns false if the job failed in any stage.
+bool write(ModuleJob& job) {
+    if (!job.error.empty()) {
+        return fail(job.path, job.error);
+    }
+    StringRef inputName = sys::path::filename(job.path);
+    if (!ResultsDirectory.empty()) {
+        SmallString<128> resultsPath(ResultsDirectory);
+        sys::path::append(resultsPath, inputName + ".out");
+        std::error_code error;
+        raw_fd_ostream out(resultsPath, error, sys::fs::OF_None);
+        if (error) {
+            return fail(resultsPath, error.message());
+        }
+        job.results.writeTo(out);
+    } else {
+        job.results.writeToOutputs();
+    }
+
+    if (OutputDirectory.empty()) {
+        return true;
+    }
+    SmallString<128> outputPath(OutputDirectory);
+    sys::path::append(outputPath, inputName);
+    sys::path::replace_extension(outputPath, EmitText ? "ll" : "bc");
+    if (!job.changed && job.bitcodeInput != EmitText) {
+        if (std::error_code error = sys::fs::copy_file(job.path, outputPath)) {
+            return fail(outputPath, error.message());
+        }
+        return true;
+    }
+    if (Error error = job.M->materializeAll()) {
+        return fail(job.path, toString(std::move(error)));
+    }
+    std::error_code error;
+    ToolOutputFile out(outputPath, error, EmitText ? sys::fs::OF_Text : sys::fs::OF_None);
+    if (error) {
+        return fail(outputPath, error.message());
+    }
+    if (EmitText) {
+        job.M->print(out.os(), nullptr);
+    } else {
+        WriteBitcodeToFile(*job.M, out.os());
+    }
+    out.keep();
+    return true;
+}
+
+// One module at a time on this thread. Results are only captured to go to
+// per-module files.
+unsigned runSequential(Pipeline& pipeline) {
+    Analyses analyses(pipeline.PB);
+    unsigned failed = 0;
+    for (const std::string& path : InputFilenames) {
+        ModuleJob job;
+        job.path = path;
+        if (load(job, pipeline)) {
+            Optional<dataflow::CaptureResults> capture;
+            if (!ResultsDirectory.empty()) {
+                capture.emplace(job.results);
+            }
+            analyze(job, pipeline, analyses);
+        }
+        failed += !write(job);
+    }
+    return failed;
+}
+
+// Lets a module in only while it is within a fixed distance of the next one to
+// be written, so the modules held at once stay bounded however uneven their cost
+class InFlightWindow {
+public:
+    explicit InFlightWindow(unsigned size) : size(size) {}
+
+    void waitFor(unsigned index) {
+        std::unique_lock<std::mutex> guard(lock);
+        advanced.wait(guard, [&] { return index < numWritten + size; });
+    }
+
+    void written() {
+        std::lock_guard<std::mutex> guard(lock);
+        numWritten++;
+        advanced.notify_all();
+    }
+
+private:
+    unsigned size;
+    unsigned numWritten = 0;
+    std::mutex lock;
+    std::condition_variable advanced;
+};
+
+// Load, analysis and output stages on their own threads, joined by bounded
+// queues, so reading and writing one module overlaps analyzing others. The
+// results are captured per module and written in input order by this thread,
+// so they come out as from a sequential run.
+unsigned runPipelined(Pipeline& pipeline, unsigned numWorkers) {
+    using JobPtr = std::unique_ptr<ModuleJob>;
+    unsigned numLoaders = std::max(1U, unsigned(LoadJobs));
+    unsigned capacity = QueueSize ? unsigned(QueueSize) : numWorkers;
+    dataflow::BoundedQueue<std::pair<unsigned, JobPtr>> loaded(capacity);
+    dataflow::BoundedQueue<std::pair<unsigned, JobPtr>> analyzed(capacity);
+    // Every module in flight is in a queue, in a stage's hands or analyzed and
+    // waiting for an earlier one
+    InFlightWindow window(2 * capacity + numLoaders + numWorkers);
+
+    std::atomic<unsigned> nextInput(0);
+    std::atomic<unsigned> loadersLeft(numLoaders);
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < numLoaders; i++) {
+        threads.emplace_back([&] {
+            for (unsigned index; (index = nextInput++) < InputFilenames.size();) {
+                window.waitFor(index);
+                JobPtr job = std::make_unique<ModuleJob>();
+                job->path = InputFilenames[index];
+                load(*job, pipeline);
+                loaded.push({index, std::move(job)});
+            }
+            if (--loadersLeft == 0) {
+                loaded.close();
+            }
+        });
+    }
+
+    std::vector<std::unique_ptr<Analyses>> analyses;
+    for (unsigned i = 0; i < numWorkers; i++) {
+        analyses.emplace_back(new Analyses(pipeline.PB));
+    }
+    std::atomic<unsigned> workersLeft(numWorkers);
+    for (unsigned i = 0; i < numWorkers; i++) {
+        threads.emplace_back([&, i] {
+            dataflow::ConcurrentPhases concurrent;
+            std::pair<unsigned, JobPtr> item;
+            while (loaded.pop(item)) {
+                if (item.second->error.empty()) {
+                    dataflow::CaptureResults capture(item.second->results);
+                    analyze(*item.second, pipeline, *analyses[i]);
+                }
+                analyzed.push(std::move(item));
+            }
+            if (--workersLeft == 0) {
+                analyzed.close();
+            }
+        });
+    }
+
+    unsigned failed = 0;
+    std::map<unsigned, JobPtr> waiting; // Analyzed ahead of a module not yet written
+    unsigned nextToWrite = 0;
+    std::pair<unsigned, JobPtr> item;
+    while (analyzed.pop(item)) {
+        waiting.emplace(item.first, std::move(item.second));
+        for (auto next = waiting.find(nextToWrite); next != waiting.end(); next = waiting.find(nextToWrite)) {
+            failed += !write(*next->second);
+            waiting.erase(next);
+            nextToWrite++;
+            window.written();
+        }
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    return failed;
+}
+
+} // end of anonymous namespace
+
+// dataflow-driver -passes=cse-elimination -cse-verbosity=summary -o out/ a.bc b.bc @more.txt
+int main(int argc, char** argv) {
+    InitLLVM init(argc, argv);
+    cl::ParseCommandLineOptions(argc, argv, "Runs the dataflow passes over many modules in one process\n");
+
+    Pipeline pipeline;
+    if (!pipeline.build()) {
+        return 1;
+    }
+    for (const std::string& directory : {std::string(OutputDirectory), std::string(ResultsDirectory)}) {
+        if (!directory.empty()) {
+            if (std::error_code error = sys::fs::create_directories(directory)) {
+                fail(directory, error.message());
+                return 1;
+            }
+        }
+    }
+
+    unsigned numWorkers = Jobs ? unsigned(Jobs) : std::max(1U, std::thread::hardware_concurrency());
+    unsigned failed = numWorkers == 1 ? runSequential(pipeline) : runPipelined(pipeline, numWorkers);
+    if (failed) {
+        errs() << "dataflow-driver: " << failed << " of " << InputFilenames.size() << " inputs failed\n";
+        return 1;
+    }
+    return 0;
+}
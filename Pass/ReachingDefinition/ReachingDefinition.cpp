@@ -1,16 +1,33 @@
+#include "llvm/IR/AssemblyAnnotationWriter.h"
 #include "llvm/IR/CFG.h"
+#include "llvm/IR/Dominators.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Module.h"
+#include "llvm/IR/PassManager.h"
 #include "llvm/IR/Type.h"
 #include "llvm/Pass.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FormattedStream.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "DataflowAnalyses.h"
+#include "InstructionIndex.h"
+#include "PhaseTimer.h"
+#include "ReachingDefinitionSets.h"
+#include "ResultWriter.h"
+#include "SparseReachingDefinitions.h"
+#include "WorkStealingPool.h"
+#include <algorithm>
 #include <fstream>
+#include <memory>
 #include <queue>
-#include <set>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -20,164 +37,361 @@ using namespace std;
 
 #define DEBUG_TYPE "ReachingDefinition"
 
-vector<unsigned> sortAndRemoveDuplicates(vector<unsigned> vec) {
-    set<unsigned> vecAsSet(vec.begin(), vec.end());
-    vector<unsigned> temp(vecAsSet.begin(), vecAsSet.end());
-    return temp;
-}
+STATISTIC(NumBlocks, "Number of blocks analyzed");
+STATISTIC(NumDefinitions, "Number of definitions numbered");
+STATISTIC(NumVariables, "Number of variables defined");
+STATISTIC(NumSolverVisits, "Number of block or phi visits by the solvers");
+STATISTIC(NumPhis, "Number of phis placed by the sparse engine");
 
 namespace {
-struct ReachingDefinition : public FunctionPass {
-    static char ID;
-    ReachingDefinition() : FunctionPass(ID) {}
+enum class RDEngine { Dense, Sparse };
 
-    bool runOnFunction(Function& F) override {
-        errs() << "\nFunction: " << F.getName() << "\n";
+static cl::opt<RDEngine> RDMode(
+    "rd-mode", cl::desc("Reaching definitions engine"), cl::init(RDEngine::Dense),
+    cl::values(clEnumValN(RDEngine::Dense, "dense", "Bit-vector sets propagated through every block"),
+               clEnumValN(RDEngine::Sparse, "sparse", "Per-variable def-use chains over the dominator tree")));
 
-        vector<unsigned> storeInstructionIndices;
-        vector<Value*> storeInstructionDestVars;
-        unsigned instrIndex = 0;
-        unsigned blockNum = 0;
+static cl::opt<unsigned> RDThreads(
+    "rd-threads", cl::desc("Worker threads for -ReachingDefinitionModule (0 = one per hardware thread)"), cl::init(0));
+
+static cl::opt<dataflow::Verbosity> RDVerbosity(
+    "rd-verbosity", cl::desc("How much of the analysis to report"), cl::init(dataflow::Verbosity::Sets),
+    cl::values(clEnumValN(dataflow::Verbosity::None, "none", "Nothing"),
+               clEnumValN(dataflow::Verbosity::Summary, "summary", "Function headers and solver counts"),
+               clEnumValN(dataflow::Verbosity::Sets, "sets", "Instruction listing and per-block sets"),
+               clEnumValN(dataflow::Verbosity::Trace, "trace", "Everything (debug builds only)")));
+
+static cl::opt<dataflow::OutputFormat> RDFormat(
+    "rd-format", cl::desc("Format of the reported sets"), cl::init(dataflow::OutputFormat::Text),
+    cl::values(clEnumValN(dataflow::OutputFormat::Text, "text", "Human-readable listing"),
+               clEnumValN(dataflow::OutputFormat::JSON, "json", "One JSON object per line"),
+               clEnumValN(dataflow::OutputFormat::Binary, "binary", "Little-endian record stream")));
+
+static cl::opt<string> RDOutput(
+    "rd-output", cl::desc("File to write the results to ('-' for stderr)"), cl::value_desc("filename"), cl::init("-"));
+
+static cl::opt<bool> RDPerfCounters(
+    "rd-perf-counters",
+    cl::desc("Report hardware counters (cycles, instructions, cache and branch misses, page faults) per phase"),
+    cl::init(false));
+
+const char* const AnalysisName = "reaching-definitions";
 
-        // First Pass: Get all of the indexes and destination variables of the store instructions
-        for (auto &basic_block : F) {  // Iterates over basic blocks of the function 
-            errs() << "Block " << blockNum++ << ":\n";
+// Brackets every instruction in a function printout with marker bytes, which
+// never occur in printed IR (string constants are printed with escapes)
+struct InstructionMarker : public AssemblyAnnotationWriter {
+    void emitInstructionAnnot(const Instruction*, formatted_raw_ostream& out) override { out << '\x01'; }
 
-            for (auto &inst : basic_block) {  // Iterates over instructions in a basic block
-                errs() << instrIndex << ": " << inst;
+    void printInfoComment(const Value& value, formatted_raw_ostream& out) override {
+        if (isa<Instruction>(value)) {
+            out << '\x02';
+        }
+    }
+};
+
+// Print every instruction with its index; the sets below refer to stores by these indices
+void printInstructions(raw_ostream& out, Function& F) {
+    // Printing instructions one by one sets up a printer, which walks the whole
+    // module, per instruction. Print the function once and cut the text of each
+    // instruction out of that instead.
+    SmallString<0> printed;
+    raw_svector_ostream printedStream(printed);
+    InstructionMarker marker;
+    F.print(printedStream, &marker);
+
+    dataflow::InstructionIndex instrs(F);
+    std::vector<StringRef> instrText(instrs.size()); // Instruction index -> its printed text
+    size_t position = 0;
+    for (unsigned instrIndex = 0; instrIndex < instrs.size(); instrIndex++) {
+        size_t begin = printed.find('\x01', position) + 1;
+        position = printed.find('\x02', begin);
+        instrText[instrIndex] = printed.slice(begin, position);
+    }
+
+    for (unsigned blockNum = 0; blockNum < instrs.numBlocks(); blockNum++) { // Iterates over basic blocks of the function
+        out << "Block " << blockNum << ":\n";
 
-                if (inst.getOpcode() == Instruction::Store) {
-                    Value* storeDestination = inst.getOperand(1);
-                    errs() << " (store w/ destination: " << *storeDestination << ")";
-                    storeInstructionIndices.push_back(instrIndex);
-                    storeInstructionDestVars.push_back(storeDestination);
+        for (unsigned instrIndex = instrs.blockStart[blockNum]; instrIndex < instrs.blockStart[blockNum + 1]; instrIndex++) {
+            Instruction& inst = *instrs.at(instrIndex);
+            out << instrIndex << ": " << instrText[instrIndex];
+
+            if (inst.getOpcode() == Instruction::Store) {
+                Value* storeDestination = inst.getOperand(1);
+                out << " (store w/ destination: ";
+                auto* destinationInst = dyn_cast<Instruction>(storeDestination);
+                if (destinationInst && destinationInst->getFunction() == &F) {
+                    out << instrText[instrs.indexOf(destinationInst)];
+                } else {
+                    out << *storeDestination;
                 }
-                errs() << "\n";
-                instrIndex++;
+                out << ")";
             }
-            errs() << "\n";
+            out << "\n";
+        }
+        out << "\n";
+    }
+}
+
+// Function header and instruction listing; prints IR, so only from the main thread
+void beginFunction(dataflow::ResultWriter& writer, Function& F) {
+    writer.function(F.getName());
+    if (raw_ostream* out = writer.textAt(dataflow::Verbosity::Sets)) {
+        printInstructions(*out, F);
+    }
+}
+
+void writeBlockSets(dataflow::ResultWriter& writer, const dataflow::DefinitionIndex& defs, unsigned blockNum,
+                    const BitVector& IN, const BitVector& OUT, const BitVector& GEN, const BitVector& KILL) {
+    if (!writer.enabled(dataflow::Verbosity::Sets)) {
+        return;
+    }
+    SmallVector<unsigned, 16> in, out, gen, kill;
+    defs.instrIndicesOf(IN, in);
+    defs.instrIndicesOf(OUT, out);
+    defs.instrIndicesOf(GEN, gen);
+    defs.instrIndicesOf(KILL, kill);
+    writer.blockSets(AnalysisName, blockNum, {{"IN", in}, {"OUT", out}, {"GEN", gen}, {"KILL", kill}});
+}
+
+// Dense engine: bit-vector GEN, KILL, IN and OUT over the store instructions
+void reportDense(dataflow::ResultWriter& writer, Function& F, const dataflow::ReachingDefinitionSets& reachingDefs) {
+    NumBlocks += reachingDefs.genSets.size();
+    NumDefinitions += reachingDefs.numDefinitions();
+    NumVariables += reachingDefs.variables.size();
+    NumSolverVisits += reachingDefs.iterations;
+
+    dataflow::PhaseTimer phases(AnalysisName, "Reaching definitions", F.getName());
+    phases.start("rd-report", "Report reaching definitions");
+    // Report IN, OUT, GEN, KILL for each block
+    for (unsigned int i = 0; i < reachingDefs.genSets.size(); ++i) {
+        writeBlockSets(writer, reachingDefs, i, reachingDefs.inSets.at(i), reachingDefs.outSets.at(i),
+                       reachingDefs.genSets.at(i), reachingDefs.killSets.at(i));
+    }
+    if (raw_ostream* out = writer.textAt(dataflow::Verbosity::Summary)) {
+        *out << "\nReaching definitions converged after " << reachingDefs.iterations << " block visits\n";
+    }
+    writer.counter(AnalysisName, "block-visits", reachingDefs.iterations);
+}
+
+// Sparse engine: same per-block sets, built from per-variable def-use chains,
+// followed by the definitions reaching every load
+void analyzeSparse(dataflow::ResultWriter& writer, Function& F, const dataflow::CFGIndex& cfg, DominatorTree& DT) {
+    dataflow::SparseReachingDefinitions reachingDefs;
+    reachingDefs.compute(F, cfg, DT);
+    NumBlocks += cfg.size();
+    NumDefinitions += reachingDefs.numDefinitions();
+    NumVariables += reachingDefs.variables.size();
+    NumSolverVisits += reachingDefs.iterations;
+    NumPhis += reachingDefs.numPhis();
+
+    dataflow::PhaseTimer phases("sparse-reaching-definitions", "Sparse reaching definitions", F.getName());
+    phases.start("srd-report", "Report reaching definitions");
+    if (writer.enabled(dataflow::Verbosity::Sets)) {
+        for (unsigned int i = 0; i < cfg.size(); ++i) {
+            writeBlockSets(writer, reachingDefs, i, reachingDefs.blockIn(i), reachingDefs.blockOut(i),
+                           reachingDefs.blockGen(i), reachingDefs.blockKill(i));
         }
 
-        instrIndex = 0;
-        blockNum = 0;
-        vector<vector<unsigned>> blockGenSets = {};
-        vector<vector<unsigned>> blockKillSets = {};
-
-        // Second Pass: Add to GEN and KILL sets
-        for (auto &basic_block : F) {  // Iterates over basic blocks of the function 
-            vector<vector<unsigned>> GEN_KILLSETS = {};
-            vector<unsigned> GEN = {};
-            vector<unsigned> KILL = {};
-
-            for (auto &inst : basic_block) {  // Iterates over instructions in a basic block
-                if (inst.getOpcode() == Instruction::Store) {
-                    GEN.push_back(instrIndex);  // Each store instruction is a GEN
-                    Value* storeDestination = inst.getOperand(1);
-
-                    // Find other instructions that change the same variable; add them to block's KILL
-                    for (unsigned int i = 0; i < storeInstructionDestVars.size(); i++) {
-                        if ((storeInstructionDestVars.at(i) == storeDestination) && (storeInstructionIndices.at(i) != instrIndex)) {
-                            KILL.push_back(storeInstructionIndices.at(i));
-                        }
+        if (raw_ostream* out = writer.textAt(dataflow::Verbosity::Sets)) {
+            *out << "\nReaching definitions at each load:\n";
+        }
+        unsigned instrIndex = 0;
+        SmallVector<unsigned, 8> defs;
+        for (auto& basic_block : F) {
+            for (auto& inst : basic_block) {
+                if (auto* load = dyn_cast<LoadInst>(&inst)) {
+                    defs.clear();
+                    reachingDefs.reachingAtLoad(load, defs);
+                    for (unsigned& def : defs) {
+                        def = reachingDefs.definitionInstrIndex[def];
                     }
+                    writer.pointSet(AnalysisName, instrIndex, {"defs", defs});
                 }
                 instrIndex++;
             }
-            blockGenSets.push_back(GEN);
-            blockKillSets.push_back(KILL);
-            blockNum++;
         }
+    }
+    if (raw_ostream* out = writer.textAt(dataflow::Verbosity::Summary)) {
+        *out << "\nSparse reaching definitions placed " << reachingDefs.numPhis() << " phis over "
+             << reachingDefs.variables.size() << " variables, converged after " << reachingDefs.iterations << " phi visits\n";
+    }
+    writer.counter(AnalysisName, "phis", reachingDefs.numPhis());
+    writer.counter(AnalysisName, "variables", reachingDefs.variables.size());
+    writer.counter(AnalysisName, "phi-visits", reachingDefs.iterations);
+}
+
+// Runs the selected engine and reports the sets. Only reads the IR and never
+// prints an IR value, so it is safe to run on several functions at once.
+void analyzeFunction(dataflow::ResultWriter& writer, Function& F, DominatorTree* DT) {
+    dataflow::CFGIndex cfg(F);
+    if (RDMode == RDEngine::Sparse) {
+        analyzeSparse(writer, F, cfg, *DT);
+    } else {
+        dataflow::ReachingDefinitionSets reachingDefs;
+        reachingDefs.compute(F, cfg);
+        reportDense(writer, F, reachingDefs);
+    }
+}
+
+struct ReachingDefinition : public FunctionPass {
+    static char ID;
+    ReachingDefinition() : FunctionPass(ID) {}
+
+    bool doInitialization(Module& M) override {
+        if (Error error = output.open(RDOutput, RDFormat)) {
+            M.getContext().emitError("-rd-output: " + toString(std::move(error)));
+        }
+        return false;
+    }
+
+    bool runOnFunction(Function& F) override {
+        dataflow::ResultWriter writer(RDVerbosity, RDFormat);
+        beginFunction(writer, F);
+        dataflow::PhaseProfile profile(RDPerfCounters, writer, output.stream());
+        analyzeFunction(writer, F, &getAnalysis<DominatorTreeWrapperPass>().getDomTree());
+        writer.flushTo(output.stream());
+        return true;
+    }
+
+    bool doFinalization(Module& M) override {
+        output.close();
+        return false;
+    }
 
-        vector<unsigned> setTemp = {};
-        vector<vector<unsigned>> blockInSets(blockNum, setTemp);
-        vector<vector<unsigned>> blockOutSets(blockNum, setTemp);
+    void getAnalysisUsage(AnalysisUsage& AU) const override {
+        AU.addRequired<DominatorTreeWrapperPass>();
+        AU.setPreservesAll();
+    }
 
-        instrIndex = 0;
-        blockNum = 0;
+private:
+    dataflow::ResultOutput output;
+}; // end of struct ReachingDefinition
 
-        // Create the IN and OUT set for each block
-        for (auto &basic_block : F) {
-            vector<unsigned> IN = {};
-            vector<unsigned> OUT = {};
+// Module-wide driver: analyzes the functions of a module concurrently on a
+// work-stealing pool, largest functions (by instruction count) first. Each
+// function's sets are rendered into their own ResultWriter and printed in function
+// order once every task is done, so the output matches -ReachingDefinition.
+struct ReachingDefinitionModule : public ModulePass {
+    static char ID;
+    ReachingDefinitionModule() : ModulePass(ID) {}
 
-            // Initial block has no IN
-            if (blockNum == 0) {
-                IN = {};
-            }
-            else {
-                // Use the block's predecessors for IN
-                for (auto *pred: predecessors(&basic_block)) {
-                    unsigned predBlockNum = 0;
-                    for (auto &funcBlock : F) {
-                        // Find block number for predecessor
-                        if (&funcBlock == pred) {
-                            break;
-                        }
-                        predBlockNum++;
-                    }
-                    // IN is the OUT of the predecessor
-                    for (unsigned int i = 0; i < blockOutSets.at(predBlockNum).size(); i++) {
-                        IN.push_back(blockOutSets.at(predBlockNum).at(i));
-                    }
-                }
+    bool runOnModule(Module& M) override {
+        dataflow::ResultOutput output;
+        if (Error error = output.open(RDOutput, RDFormat)) {
+            M.getContext().emitError("-rd-output: " + toString(std::move(error)));
+            return false;
+        }
+        vector<Function*> functions;
+        for (auto& F : M) {
+            if (!F.isDeclaration()) {
+                functions.push_back(&F);
             }
+        }
+
+        // Schedule the most expensive functions first
+        vector<unsigned> schedule(functions.size());
+        vector<unsigned> cost(functions.size());
+        for (unsigned i = 0; i < functions.size(); i++) {
+            schedule[i] = i;
+            cost[i] = functions[i]->getInstructionCount();
+        }
+        stable_sort(schedule.begin(), schedule.end(), [&](unsigned a, unsigned b) { return cost[a] > cost[b]; });
 
-            // Convert GEN, KILL, IN, OUT to sets to sort and remove duplicates
-            set<unsigned> currGen(blockGenSets.at(blockNum).begin(), blockGenSets.at(blockNum).end());
-            set<unsigned> currKill(blockKillSets.at(blockNum).begin(), blockKillSets.at(blockNum).end());
-            set<unsigned> currIn(IN.begin(), IN.end());
-            set<unsigned> currOut(OUT.begin(), OUT.end());
-
-            // OUT = (IN - KILL) + GEN; result is stored in currOut
-            set_difference(currIn.begin(), currIn.end(), currKill.begin(), currKill.end(), inserter(currOut, currOut.begin()));
-            set_union(currGen.begin(), currGen.end(), currOut.begin(), currOut.end(), inserter(currOut, currOut.begin()));
-            
-            // Turn OUT back into a vector
-            vector<unsigned> temp(currOut.begin(), currOut.end());
-            OUT = temp;
-
-            // Update IN and OUT for the block
-            blockInSets.at(blockNum) = IN;
-            blockOutSets.at(blockNum) = OUT;
-
-            blockNum++;
+        vector<unique_ptr<dataflow::ResultWriter>> results;
+        vector<dataflow::WorkStealingPool::Task> tasks;
+        for (unsigned i = 0; i < functions.size(); i++) {
+            results.emplace_back(new dataflow::ResultWriter(RDVerbosity, RDFormat));
+            results[i]->setFunction(functions[i]->getName());
+        }
+        for (unsigned i : schedule) {
+            tasks.push_back([&, i] {
+                dataflow::ConcurrentPhases concurrent;
+                dataflow::PhaseProfile profile(RDPerfCounters, *results[i]);
+                if (RDMode == RDEngine::Sparse) {
+                    DominatorTree DT(*functions[i]);
+                    analyzeFunction(*results[i], *functions[i], &DT);
+                } else {
+                    analyzeFunction(*results[i], *functions[i], nullptr);
+                }
+            });
         }
+        dataflow::WorkStealingPool pool(RDThreads);
+        pool.run(std::move(tasks));
 
-        // Print IN, OUT, GEN, KILL for each block
-        for (unsigned int i = 0; i < blockGenSets.size(); ++i) {
-            errs() << "\nBlock " << i << ":";
+        // Merge in function order; the instruction listing prints IR, so it stays on this thread
+        for (unsigned i = 0; i < functions.size(); i++) {
+            dataflow::ResultWriter header(RDVerbosity, RDFormat);
+            beginFunction(header, *functions[i]);
+            header.flushTo(output.stream());
+            results[i]->flushTo(output.stream());
+        }
+        return false;
+    }
 
-            errs() << "\n  IN: ";
-            blockInSets.at(i) = sortAndRemoveDuplicates(blockInSets.at(i));
-            for (unsigned int j = 0; j < blockInSets.at(i).size(); ++j) {
-                errs() << blockInSets.at(i).at(j) << " ";
-            }
+    void getAnalysisUsage(AnalysisUsage& AU) const override {
+        AU.setPreservesAll();
+    }
+}; // end of struct ReachingDefinitionModule
 
-            errs() << "\n  OUT: ";
-            blockOutSets.at(i) = sortAndRemoveDuplicates(blockOutSets.at(i));
-            for (unsigned int k = 0; k < blockOutSets.at(i).size(); ++k) {
-                errs() << blockOutSets.at(i).at(k) << " ";
-            }
+// New pass manager version: prints the ReachingDefinitionAnalysis result cached
+// in the FunctionAnalysisManager, so later passes reuse the same computation
+struct ReachingDefinitionPrinterPass : public PassInfoMixin<ReachingDefinitionPrinterPass> {
+    ReachingDefinitionPrinterPass() : output(std::make_shared<dataflow::ResultOutput>()) {
+        if (Error error = output->open(RDOutput, RDFormat)) {
+            openError = "-rd-output: " + toString(std::move(error));
+        }
+    }
 
-            errs() << "\n  GEN: ";
-            blockGenSets.at(i) = sortAndRemoveDuplicates(blockGenSets.at(i));
-            for (unsigned int m = 0; m < blockGenSets.at(i).size(); ++m) {
-                errs() << blockGenSets.at(i).at(m) << " ";
-            }
+    // Run on optnone functions too (clang -O0 output marks every function optnone)
+    static bool isRequired() { return true; }
 
-            errs() << "\n  KILL: ";
-            blockKillSets.at(i) = sortAndRemoveDuplicates(blockKillSets.at(i));
-            for (unsigned int n = 0; n < blockKillSets.at(i).size(); ++n) {
-                errs() << blockKillSets.at(i).at(n) << " ";
-            }
-            errs() << "\n";
+    PreservedAnalyses run(Function& F, FunctionAnalysisManager& FAM) {
+        if (!openError.empty()) {
+            // Reported on each function, as the pass cannot fail while the pipeline is built
+            F.getContext().emitError(openError);
+            return PreservedAnalyses::all();
         }
-        return true;
+        dataflow::ResultWriter writer(RDVerbosity, RDFormat);
+        beginFunction(writer, F);
+        dataflow::PhaseProfile profile(RDPerfCounters, writer, output->stream());
+        if (RDMode == RDEngine::Sparse) {
+            analyzeSparse(writer, F, FAM.getResult<dataflow::CFGIndexAnalysis>(F), FAM.getResult<DominatorTreeAnalysis>(F));
+        } else {
+            reportDense(writer, F, FAM.getResult<dataflow::ReachingDefinitionAnalysis>(F));
+        }
+        writer.flushTo(output->stream());
+        return PreservedAnalyses::all();
     }
-}; // end of struct ReachingDefinition
+
+private:
+    shared_ptr<dataflow::ResultOutput> output; // Shared by the copies the pipeline makes
+    string openError;                          // Why -rd-output could not be opened
+}; // end of struct ReachingDefinitionPrinterPass
 } // end of anonymous namespace
 
 char ReachingDefinition::ID = 0;
 static RegisterPass<ReachingDefinition> X("ReachingDefinition", "Reaching Definition Pass",
                                           false /* Only looks at CFG */,
                                           true /* Analysis Pass */);
+
+char ReachingDefinitionModule::ID = 0;
+static RegisterPass<ReachingDefinitionModule> Y("ReachingDefinitionModule", "Reaching Definition Pass (parallel, whole module)",
+                                                false /* Only looks at CFG */,
+                                                true /* Analysis Pass */);
+
+void dataflow::registerReachingDefinitionPasses(PassBuilder& PB) {
+    registerDataflowAnalyses(PB);
+    PB.registerPipelineParsingCallback(
+        [](StringRef name, FunctionPassManager& FPM, ArrayRef<PassBuilder::PipelineElement>) {
+            if (name == "print<reaching-definitions>") {
+                FPM.addPass(ReachingDefinitionPrinterPass());
+                return true;
+            }
+            return false;
+        });
+}
+
+// opt -load-pass-plugin=libReachingDefinition.so -passes='print<reaching-definitions>'
+extern "C" LLVM_ATTRIBUTE_WEAK PassPluginLibraryInfo llvmGetPassPluginInfo() {
+    return {LLVM_PLUGIN_API_VERSION, "ReachingDefinition", LLVM_VERSION_STRING, dataflow::registerReachingDefinitionPasses};
+}
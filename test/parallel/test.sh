@@ -0,0 +1,33 @@
+# Checks that the parallel runs give the same bytes as serial ones: the
+# ReachingDefinitionModule pass against ReachingDefinition, and
+# dataflow-driver with several jobs against one job, on generated modules
+# of several functions each and on the phase2/phase3 inputs.
+opt=../../LLVM/install/bin/opt
+gen=../../Pass/build/Benchmark/dataflow-gen
+driver=../../Pass/build/Driver/dataflow-driver
+threads=${1:-4}
+status=0
+
+rm -rf work
+mkdir -p work/serial work/parallel
+for seed in 1 2 3 4; do
+  $gen -functions=12 -blocks=100 -seed=$seed -S -o work/gen$seed.ll
+done
+modules="work/gen*.ll ../phase2/test.ll ../phase3/*.ll"
+
+for module in $modules; do
+  name=$(basename $module)
+  $opt -S -load ../../Pass/build/libReachingDefinition.so -ReachingDefinition < $module > /dev/null 2> work/serial/$name.rd
+  $opt -S -load ../../Pass/build/libReachingDefinition.so -ReachingDefinitionModule -rd-threads=$threads < $module > /dev/null 2> work/parallel/$name.rd
+  cmp work/serial/$name.rd work/parallel/$name.rd || status=1
+done
+
+pipeline='print<reaching-definitions>,cse-elimination'
+$driver -passes=$pipeline -cse-mode=dataflow -j=1 -S -results-dir=work/serial -o work/serial $modules
+$driver -passes=$pipeline -cse-mode=dataflow -j=$threads -load-jobs=2 -S -results-dir=work/parallel -o work/parallel $modules
+diff -r work/serial work/parallel || status=1
+
+if [ $status -eq 0 ]; then
+  rm -rf work
+fi
+exit $status
@@ -1 +1,15 @@
-../../LLVM/install/bin/opt -S -load ../../Pass/build/libReachingDefinition.so -ReachingDefinition < $1 > /dev/null 2> $1.out
+# Runs both reaching definitions engines. The first run of an input saves the
+# dense result as $1.out; later runs check both engines against it. The lines
+# about how the solver converged differ by engine and are left out of the check.
+summary='/converged after/d; /^Reaching definitions at each load:/,/^$/d'
+status=0
+for mode in dense sparse; do
+  ../../LLVM/install/bin/opt -S -load ../../Pass/build/libReachingDefinition.so -ReachingDefinition -rd-mode=$mode < $1 > /dev/null 2> $1.$mode.out
+  if [ ! -f $1.out ]; then
+    cp $1.$mode.out $1.out
+  fi
+  sed "$summary" $1.out > $1.expected
+  sed "$summary" $1.$mode.out | diff -u $1.expected - || status=1
+done
+rm -f $1.expected
+exit $status
@@ -0,0 +1,14 @@
+void test(int n) {
+  int a, b, c, d, e, x, y;
+  a = n;
+  b = n + 1;
+  c = n + 2;
+  d = n + 3;
+  e = n + 4;
+  x = (a + b) * (c - d) + e * a;
+  if (n > 0) {
+    b = x;
+  }
+  y = (a + b) * (c - d) + e * a;
+  x = (a + b) * (c - d) + e * a;
+}
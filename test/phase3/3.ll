@@ -0,0 +1,86 @@
+; ModuleID = '3.c'
+source_filename = "3.c"
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+; Function Attrs: noinline nounwind uwtable
+define dso_local void @test(i32 %0) #0 {
+  %2 = alloca i32, align 4
+  %3 = alloca i32, align 4
+  %4 = alloca i32, align 4
+  %5 = alloca i32, align 4
+  %6 = alloca i32, align 4
+  %7 = alloca i32, align 4
+  %8 = alloca i32, align 4
+  %9 = alloca i32, align 4
+  store i32 %0, i32* %2, align 4
+  %10 = load i32, i32* %2, align 4
+  store i32 %10, i32* %3, align 4
+  %11 = load i32, i32* %2, align 4
+  %12 = add nsw i32 %11, 1
+  store i32 %12, i32* %4, align 4
+  %13 = load i32, i32* %2, align 4
+  %14 = add nsw i32 %13, 2
+  store i32 %14, i32* %5, align 4
+  %15 = load i32, i32* %2, align 4
+  %16 = add nsw i32 %15, 3
+  store i32 %16, i32* %6, align 4
+  %17 = load i32, i32* %2, align 4
+  %18 = add nsw i32 %17, 4
+  store i32 %18, i32* %7, align 4
+  %19 = load i32, i32* %3, align 4
+  %20 = load i32, i32* %4, align 4
+  %21 = add nsw i32 %19, %20
+  %22 = load i32, i32* %5, align 4
+  %23 = load i32, i32* %6, align 4
+  %24 = sub nsw i32 %22, %23
+  %25 = mul nsw i32 %21, %24
+  %26 = load i32, i32* %7, align 4
+  %27 = load i32, i32* %3, align 4
+  %28 = mul nsw i32 %26, %27
+  %29 = add nsw i32 %25, %28
+  store i32 %29, i32* %8, align 4
+  %30 = load i32, i32* %2, align 4
+  %31 = icmp sgt i32 %30, 0
+  br i1 %31, label %32, label %34
+
+32:                                               ; preds = %1
+  %33 = load i32, i32* %8, align 4
+  store i32 %33, i32* %4, align 4
+  br label %34
+
+34:                                               ; preds = %32, %1
+  %35 = load i32, i32* %3, align 4
+  %36 = load i32, i32* %4, align 4
+  %37 = add nsw i32 %35, %36
+  %38 = load i32, i32* %5, align 4
+  %39 = load i32, i32* %6, align 4
+  %40 = sub nsw i32 %38, %39
+  %41 = mul nsw i32 %37, %40
+  %42 = load i32, i32* %7, align 4
+  %43 = load i32, i32* %3, align 4
+  %44 = mul nsw i32 %42, %43
+  %45 = add nsw i32 %41, %44
+  store i32 %45, i32* %9, align 4
+  %46 = load i32, i32* %3, align 4
+  %47 = load i32, i32* %4, align 4
+  %48 = add nsw i32 %46, %47
+  %49 = load i32, i32* %5, align 4
+  %50 = load i32, i32* %6, align 4
+  %51 = sub nsw i32 %49, %50
+  %52 = mul nsw i32 %48, %51
+  %53 = load i32, i32* %7, align 4
+  %54 = load i32, i32* %3, align 4
+  %55 = mul nsw i32 %53, %54
+  %56 = add nsw i32 %52, %55
+  store i32 %56, i32* %8, align 4
+  ret void
+}
+
+attributes #0 = { noinline nounwind uwtable "disable-tail-calls"="false" "frame-pointer"="all" "less-precise-fpmad"="false" "min-legal-vector-width"="0" "no-infs-fp-math"="false" "no-jump-tables"="false" "no-nans-fp-math"="false" "no-signed-zeros-fp-math"="false" "no-trapping-math"="true" "stack-protector-buffer-size"="8" "target-cpu"="x86-64" "target-features"="+cx8,+fxsr,+mmx,+sse,+sse2,+x87" "tune-cpu"="generic" "unsafe-fp-math"="false" "use-soft-float"="false" }
+
+!llvm.module.flags = !{!0}
+!llvm.ident = !{!1}
+
+!0 = !{i32 1, !"wchar_size", i32 4}
+!1 = !{!"clang version 12.0.1"}
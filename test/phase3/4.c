@@ -0,0 +1,9 @@
+void test(int n, int b, int c) {
+  int x, y;
+  if (n > 0) {
+    x = b + c;
+  } else {
+    x = n;
+  }
+  y = b + c;
+}
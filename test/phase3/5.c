@@ -0,0 +1,9 @@
+void test(int n) {
+  int x, y, z;
+  x = n;
+  y = x + 1;
+  if (n > 0) {
+    x = y;
+  }
+  z = x * x + y;
+}
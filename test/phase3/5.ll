@@ -0,0 +1,43 @@
+; ModuleID = '5.c'
+source_filename = "5.c"
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+; Function Attrs: noinline nounwind uwtable
+define dso_local void @test(i32 %0) #0 {
+  %2 = alloca i32, align 4
+  %3 = alloca i32, align 4
+  %4 = alloca i32, align 4
+  %5 = alloca i32, align 4
+  store i32 %0, i32* %2, align 4
+  %6 = load i32, i32* %2, align 4
+  store i32 %6, i32* %3, align 4
+  %7 = load i32, i32* %3, align 4
+  %8 = add nsw i32 %7, 1
+  store i32 %8, i32* %4, align 4
+  %9 = load i32, i32* %2, align 4
+  %10 = icmp sgt i32 %9, 0
+  br i1 %10, label %11, label %13
+
+11:                                               ; preds = %1
+  %12 = load i32, i32* %4, align 4
+  store i32 %12, i32* %3, align 4
+  br label %13
+
+13:                                               ; preds = %11, %1
+  %14 = load i32, i32* %3, align 4
+  %15 = load i32, i32* %3, align 4
+  %16 = mul nsw i32 %14, %15
+  %17 = load i32, i32* %4, align 4
+  %18 = add nsw i32 %16, %17
+  store i32 %18, i32* %5, align 4
+  ret void
+}
+
+attributes #0 = { noinline nounwind uwtable "disable-tail-calls"="false" "frame-pointer"="all" "less-precise-fpmad"="false" "min-legal-vector-width"="0" "no-infs-fp-math"="false" "no-jump-tables"="false" "no-nans-fp-math"="false" "no-signed-zeros-fp-math"="false" "no-trapping-math"="true" "stack-protector-buffer-size"="8" "target-cpu"="x86-64" "target-features"="+cx8,+fxsr,+mmx,+sse,+sse2,+x87" "tune-cpu"="generic" "unsafe-fp-math"="false" "use-soft-float"="false" }
+
+!llvm.module.flags = !{!0}
+!llvm.ident = !{!1}
+
+!0 = !{i32 1, !"wchar_size", i32 4}
+!1 = !{!"clang version 12.0.1"}
@@ -1 +1,8 @@
-../../LLVM/install/bin/opt -S -load ../../Pass/build/libCSElimination.so -CSElimination < $1 > $1.out
\ No newline at end of file
+../../LLVM/install/bin/opt -S -load ../../Pass/build/libCSElimination.so -CSElimination < $1 > $1.out
+for mode in scoped dataflow pre; do
+  ../../LLVM/install/bin/opt -S -load ../../Pass/build/libCSElimination.so -CSElimination -cse-mode=$mode < $1 > $1.$mode.out
+done
+# Redundant load elimination on top of the default mode
+../../LLVM/install/bin/opt -S -load ../../Pass/build/libCSElimination.so -CSElimination -cse-loads < $1 > $1.loads.out
+# Each incremental update of the dataflow sets between rounds must match a fresh computation
+../../LLVM/install/bin/opt -S -load ../../Pass/build/libCSElimination.so -CSElimination -cse-mode=dataflow -cse-verify-updates -cse-verbosity=none < $1 > /dev/null